@@ -1,330 +1,7328 @@
-#include <iostream>
-#include <vector>
-#include <string>
-#include <fstream>
-#include <cstdint>
-#include <type_traits>
-#include <variant>
-#include <algorithm>
-
-using Id = uint64_t;
-using Buffer = std::vector<std::byte>;
-
-enum class TypeId : Id {
-    Uint,
-    Float,
-    String,
-    Vector
-};
-
-// Helper для преобразования чисел в little-endian
-template<typename T>
-std::vector<std::byte> toLittleEndian(T value) {
-    std::vector<std::byte> result(sizeof(T));
-    for (size_t i = 0; i < sizeof(T); ++i) {
-        result[i] = static_cast<std::byte>(value & 0xFF);
-        value >>= 8;
-    }
-    return result;
-}
-
-// Helper для чтения чисел из little-endian
-template<typename T>
-T fromLittleEndian(const std::byte* data) {
-    T result = 0;
-    for (size_t i = 0; i < sizeof(T); ++i) {
-        result |= static_cast<T>(data[i]) << (i * 8);
-    }
-    return result;
-}
-
-// Базовый тип IntegerType
-class IntegerType {
-public:
-    explicit IntegerType(uint64_t value = 0) : value_(value) {}
-
-    void serialize(Buffer& buffer) const {
-        auto le = toLittleEndian(value_);
-        buffer.insert(buffer.end(), le.begin(), le.end());
-    }
-
-    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
-        if (std::distance(begin, end) < sizeof(uint64_t)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        value_ = fromLittleEndian<uint64_t>(&(*begin));
-        return begin + sizeof(uint64_t);
-    }
-
-    uint64_t getValue() const { return value_; }
-
-private:
-    uint64_t value_;
-};
-
-// Базовый тип FloatType
-class FloatType {
-public:
-    explicit FloatType(double value = 0.0) : value_(value) {}
-
-    void serialize(Buffer& buffer) const {
-        auto le = toLittleEndian(*reinterpret_cast<uint64_t*>(&value_));
-        buffer.insert(buffer.end(), le.begin(), le.end());
-    }
-
-    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
-        if (std::distance(begin, end) < sizeof(double)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        uint64_t rawValue = fromLittleEndian<uint64_t>(&(*begin));
-        value_ = *reinterpret_cast<double*>(&rawValue);
-        return begin + sizeof(double);
-    }
-
-    double getValue() const { return value_; }
-
-private:
-    double value_;
-};
-
-// Базовый тип StringType
-class StringType {
-public:
-    explicit StringType(const std::string& value = "") : value_(value) {}
-
-    void serialize(Buffer& buffer) const {
-        auto sizeLe = toLittleEndian(static_cast<uint64_t>(value_.size()));
-        buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
-        buffer.insert(buffer.end(), reinterpret_cast<const std::byte*>(value_.data()),
-                      reinterpret_cast<const std::byte*>(value_.data() + value_.size()));
-    }
-
-    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
-        if (std::distance(begin, end) < sizeof(uint64_t)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        uint64_t size = fromLittleEndian<uint64_t>(&(*begin));
-        begin += sizeof(uint64_t);
-        if (std::distance(begin, end) < static_cast<int64_t>(size)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        value_.assign(reinterpret_cast<const char*>(&(*begin)), size);
-        return begin + size;
-    }
-
-    const std::string& getValue() const { return value_; }
-
-private:
-    std::string value_;
-};
-
-// Контейнерный тип VectorType
-class VectorType {
-public:
-    template<typename Arg>
-    void push_back(Arg&& val) {
-        elements_.emplace_back(std::forward<Arg>(val));
-    }
-
-    void serialize(Buffer& buffer) const {
-        auto sizeLe = toLittleEndian(static_cast<uint64_t>(elements_.size()));
-        buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
-        for (const auto& element : elements_) {
-            element.serialize(buffer);
-        }
-    }
-
-    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
-        if (std::distance(begin, end) < sizeof(uint64_t)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        uint64_t size = fromLittleEndian<uint64_t>(&(*begin));
-        begin += sizeof(uint64_t);
-        elements_.clear();
-        for (uint64_t i = 0; i < size; ++i) {
-            Any any;
-            begin = any.deserialize(begin, end);
-            elements_.push_back(any);
-        }
-        return begin;
-    }
-
-    const std::vector<Any>& getElements() const { return elements_; }
-
-private:
-    std::vector<Any> elements_;
-};
-
-// Универсальный тип Any
-class Any {
-public:
-    template<typename T>
-    explicit Any(T&& value) : payload_(std::forward<T>(value)) {}
-
-    void serialize(Buffer& buffer) const {
-        std::visit([&buffer](auto&& arg) {
-            using T = std::decay_t<decltype(arg)>;
-            if constexpr (std::is_same_v<T, IntegerType>) {
-                buffer.insert(buffer.end(), toLittleEndian(static_cast<uint64_t>(TypeId::Uint)).begin(),
-                              toLittleEndian(static_cast<uint64_t>(TypeId::Uint)).end());
-            } else if constexpr (std::is_same_v<T, FloatType>) {
-                buffer.insert(buffer.end(), toLittleEndian(static_cast<uint64_t>(TypeId::Float)).begin(),
-                              toLittleEndian(static_cast<uint64_t>(TypeId::Float)).end());
-            } else if constexpr (std::is_same_v<T, StringType>) {
-                buffer.insert(buffer.end(), toLittleEndian(static_cast<uint64_t>(TypeId::String)).begin(),
-                              toLittleEndian(static_cast<uint64_t>(TypeId::String)).end());
-            } else if constexpr (std::is_same_v<T, VectorType>) {
-                buffer.insert(buffer.end(), toLittleEndian(static_cast<uint64_t>(TypeId::Vector)).begin(),
-                              toLittleEndian(static_cast<uint64_t>(TypeId::Vector)).end());
-            }
-            arg.serialize(buffer);
-        }, payload_);
-    }
-
-    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
-        if (std::distance(begin, end) < sizeof(uint64_t)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        TypeId typeId = static_cast<TypeId>(fromLittleEndian<uint64_t>(&(*begin)));
-        begin += sizeof(uint64_t);
-        switch (typeId) {
-            case TypeId::Uint: {
-                IntegerType value;
-                begin = value.deserialize(begin, end);
-                payload_ = value;
-                break;
-            }
-            case TypeId::Float: {
-                FloatType value;
-                begin = value.deserialize(begin, end);
-                payload_ = value;
-                break;
-            }
-            case TypeId::String: {
-                StringType value;
-                begin = value.deserialize(begin, end);
-                payload_ = value;
-                break;
-            }
-            case TypeId::Vector: {
-                VectorType value;
-                begin = value.deserialize(begin, end);
-                payload_ = value;
-                break;
-            }
-            default:
-                throw std::runtime_error("Unknown type ID");
-        }
-        return begin;
-    }
-
-    TypeId getPayloadTypeId() const {
-        return std::visit([](auto&& arg) -> TypeId {
-            using T = std::decay_t<decltype(arg)>;
-            if constexpr (std::is_same_v<T, IntegerType>) {
-                return TypeId::Uint;
-            } else if constexpr (std::is_same_v<T, FloatType>) {
-                return TypeId::Float;
-            } else if constexpr (std::is_same_v<T, StringType>) {
-                return TypeId::String;
-            } else if constexpr (std::is_same_v<T, VectorType>) {
-                return TypeId::Vector;
-            }
-            throw std::runtime_error("Unknown type");
-        }, payload_);
-    }
-
-    template<typename T>
-    auto& getValue() const {
-        return std::get<T>(payload_);
-    }
-
-    bool operator==(const Any& other) const {
-        return std::visit([&](auto&& lhs, auto&& rhs) -> bool {
-            return lhs == rhs;
-        }, payload_, other.payload_);
-    }
-
-private:
-    std::variant<IntegerType, FloatType, StringType, VectorType> payload_;
-};
-
-// Класс Serializator
-class Serializator {
-public:
-    template<typename Arg>
-    void push(Arg&& val) {
-        storage_.emplace_back(std::forward<Arg>(val));
-    }
-
-    Buffer serialize() const {
-        Buffer buffer;
-        auto sizeLe = toLittleEndian(static_cast<uint64_t>(storage_.size()));
-        buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
-        for (const auto& element : storage_) {
-            element.serialize(buffer);
-        }
-        return buffer;
-    }
-
-    static std::vector<Any> deserialize(const Buffer& buffer) {
-        std::vector<Any> result;
-        auto begin = buffer.cbegin();
-        auto end = buffer.cend();
-        if (std::distance(begin, end) < sizeof(uint64_t)) {
-            throw std::runtime_error("Not enough data for deserialization");
-        }
-        uint64_t size = fromLittleEndian<uint64_t>(&(*begin));
-        begin += sizeof(uint64_t);
-        for (uint64_t i = 0; i < size; ++i) {
-            Any any;
-            begin = any.deserialize(begin, end);
-            result.push_back(any);
-        }
-        return result;
-    }
-
-    const std::vector<Any>& getStorage() const {
-        return storage_;
-    }
-
-private:
-    std::vector<Any> storage_;
-};
-
-int main() {
-    // Пример использования
-    std::ifstream raw("raw.bin", std::ios_base::in | std::ios_base::binary);
-    if (!raw.is_open()) {
-        std::cerr << "Failed to open raw.bin\n";
-        return 1;
-    }
-
-    raw.seekg(0, std::ios_base::end);
-    std::streamsize size = raw.tellg();
-    raw.seekg(0, std::ios_base::beg);
-
-    Buffer buff(size);
-    raw.read(reinterpret_cast<char*>(buff.data()), size);
-
-    try {
-        auto res = Serializator::deserialize(buff);
-
-        Serializator s;
-        for (auto&& i : res)
-            s.push(i);
-
-        Buffer serialized = s.serialize();
-
-        // Проверка на совпадение буферов
-        if (buff.size() != serialized.size() || !std::equal(buff.begin(), buff.end(), serialized.begin())) {
-            std::cout << "Buffers do not match.\n";
-        } else {
-            std::cout << "Buffers match.\n";
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << '\n';
-    }
-
-    return 0;
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <bit>
+#include <charconv>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using Id = uint64_t;
+using Buffer = std::vector<std::byte>;
+
+enum class TypeId : Id {
+    Uint,
+    Float,
+    String,
+    Vector,
+    Bool,
+    Bitset,
+    Tensor,
+    SparseVector,
+    Timestamp,
+    TimestampVector,
+    Null,
+    NullableVector
+};
+
+// Helper для преобразования чисел в little-endian
+template<typename T>
+constexpr std::vector<std::byte> toLittleEndian(T value) {
+    std::vector<std::byte> result(sizeof(T));
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        result[i] = static_cast<std::byte>(value & 0xFF);
+        value >>= 8;
+    }
+    return result;
+}
+
+// Запись числа в little-endian на место, без выделения памяти
+template<typename T>
+constexpr void storeLittleEndian(std::byte* out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<std::byte>(value & 0xFF);
+        value >>= 8;
+    }
+}
+
+// Helper для чтения чисел из little-endian
+template<typename T>
+constexpr T fromLittleEndian(const std::byte* data) {
+    T result = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        result |= static_cast<T>(data[i]) << (i * 8);
+    }
+    return result;
+}
+
+// Базовый тип IntegerType
+class IntegerType {
+public:
+    explicit IntegerType(uint64_t value = 0) : value_(value) {}
+
+    void serialize(Buffer& buffer) const {
+        auto le = toLittleEndian(value_);
+        buffer.insert(buffer.end(), le.begin(), le.end());
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (std::distance(begin, end) < sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        value_ = fromLittleEndian<uint64_t>(&(*begin));
+        return begin + sizeof(uint64_t);
+    }
+
+    uint64_t getValue() const { return value_; }
+
+    size_t memoryFootprint() const { return sizeof(*this); }
+
+    bool operator==(const IntegerType&) const = default;
+
+private:
+    uint64_t value_;
+};
+
+// Базовый тип FloatType
+class FloatType {
+public:
+    explicit FloatType(double value = 0.0) : value_(value) {}
+
+    void serialize(Buffer& buffer) const {
+        auto le = toLittleEndian(std::bit_cast<uint64_t>(value_));
+        buffer.insert(buffer.end(), le.begin(), le.end());
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (std::distance(begin, end) < sizeof(double)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t rawValue = fromLittleEndian<uint64_t>(&(*begin));
+        value_ = std::bit_cast<double>(rawValue);
+        return begin + sizeof(double);
+    }
+
+    double getValue() const { return value_; }
+
+    size_t memoryFootprint() const { return sizeof(*this); }
+
+    bool operator==(const FloatType&) const = default;
+
+private:
+    double value_;
+};
+
+// Базовый тип StringType
+class StringType {
+public:
+    explicit StringType(const std::string& value = "") : value_(value) {}
+
+    void serialize(Buffer& buffer) const {
+        auto sizeLe = toLittleEndian(static_cast<uint64_t>(value_.size()));
+        buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
+        buffer.insert(buffer.end(), reinterpret_cast<const std::byte*>(value_.data()),
+                      reinterpret_cast<const std::byte*>(value_.data() + value_.size()));
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (std::distance(begin, end) < sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t size = fromLittleEndian<uint64_t>(&(*begin));
+        begin += sizeof(uint64_t);
+        if (std::distance(begin, end) < static_cast<int64_t>(size)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        value_.assign(reinterpret_cast<const char*>(&(*begin)), size);
+        return begin + size;
+    }
+
+    const std::string& getValue() const { return value_; }
+
+    // Размер объекта вместе с кучей строки (capacity, а не size); короткие строки живут внутри объекта
+    size_t memoryFootprint() const {
+        auto data = reinterpret_cast<const std::byte*>(value_.data());
+        auto self = reinterpret_cast<const std::byte*>(this);
+        bool inlineStorage = data >= self && data < self + sizeof(*this);
+        return sizeof(*this) + (inlineStorage ? 0 : value_.capacity() + 1);
+    }
+
+    bool operator==(const StringType&) const = default;
+
+private:
+    std::string value_;
+};
+
+// Словные ядра для упакованных битов. Работают прямо по байтам закодированных слов:
+// AND/OR/popcount не зависят от порядка байт внутри слова.
+namespace bits {
+
+inline size_t wordCount(uint64_t bitCount) {
+    return static_cast<size_t>((bitCount + 63) / 64);
+}
+
+inline uint64_t loadWord(const std::byte* data) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    return word;
+}
+
+inline void storeWord(std::byte* data, uint64_t word) {
+    std::memcpy(data, &word, sizeof(word));
+}
+
+// Число единичных бит в wordCount словах
+inline uint64_t popcount(const std::byte* words, size_t wordCount) {
+    size_t i = 0;
+    uint64_t total = 0;
+#ifdef __AVX512VPOPCNTDQ__
+    __m512i acc = _mm512_setzero_si512();
+    for (; i + 8 <= wordCount; i += 8) {
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(words + i * 8)));
+    }
+    total += static_cast<uint64_t>(_mm512_reduce_add_epi64(acc));
+#endif
+    uint64_t partial[4] = {};
+    for (; i + 4 <= wordCount; i += 4) {
+        for (size_t k = 0; k < 4; ++k) {
+            partial[k] += static_cast<uint64_t>(std::popcount(loadWord(words + (i + k) * 8)));
+        }
+    }
+    for (; i < wordCount; ++i) {
+        total += static_cast<uint64_t>(std::popcount(loadWord(words + i * 8)));
+    }
+    return total + partial[0] + partial[1] + partial[2] + partial[3];
+}
+
+template<typename Op>
+inline void combine(const std::byte* a, const std::byte* b, std::byte* out, size_t wordCount, Op op) {
+    size_t i = 0;
+#ifdef __AVX2__
+    for (; i + 4 <= wordCount; i += 4) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i * 8));
+        __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i * 8));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 8), op(x, y));
+    }
+#endif
+    for (; i < wordCount; ++i) {
+        storeWord(out + i * 8, op(loadWord(a + i * 8), loadWord(b + i * 8)));
+    }
+}
+
+struct AndOp {
+    uint64_t operator()(uint64_t x, uint64_t y) const { return x & y; }
+#ifdef __AVX2__
+    __m256i operator()(__m256i x, __m256i y) const { return _mm256_and_si256(x, y); }
+#endif
+};
+
+struct OrOp {
+    uint64_t operator()(uint64_t x, uint64_t y) const { return x | y; }
+#ifdef __AVX2__
+    __m256i operator()(__m256i x, __m256i y) const { return _mm256_or_si256(x, y); }
+#endif
+};
+
+inline void andWords(const std::byte* a, const std::byte* b, std::byte* out, size_t wordCount) {
+    combine(a, b, out, wordCount, AndOp());
+}
+
+inline void orWords(const std::byte* a, const std::byte* b, std::byte* out, size_t wordCount) {
+    combine(a, b, out, wordCount, OrOp());
+}
+
+// Битсет внутри закодированного буфера: data указывает на полезную нагрузку BitsetType (после тега)
+struct View {
+    uint64_t bitCount = 0;
+    const std::byte* words = nullptr;
+
+    static View fromPayload(const std::byte* data, size_t size) {
+        if (size < sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        View view;
+        view.bitCount = fromLittleEndian<uint64_t>(data);
+        if (view.bitCount > (size - sizeof(uint64_t)) * 8 ||
+            bits::wordCount(view.bitCount) * 8 > size - sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        view.words = data + sizeof(uint64_t);
+        return view;
+    }
+
+    size_t wordCount() const { return bits::wordCount(bitCount); }
+
+    uint64_t count() const { return popcount(words, wordCount()); }
+
+    // Биты последнего слова за bitCount не заданы форматом и должны быть нулевыми
+    bool trailingBitsClear() const {
+        if (bitCount % 64 == 0) {
+            return true;
+        }
+        return (fromLittleEndian<uint64_t>(words + (wordCount() - 1) * 8) >> (bitCount % 64)) == 0;
+    }
+
+    bool test(uint64_t index) const {
+        if (index >= bitCount) {
+            throw std::out_of_range("Bitset index out of range");
+        }
+        return (static_cast<unsigned>(words[index / 8]) >> (index % 8)) & 1;
+    }
+};
+
+} // namespace bits
+
+// Базовый тип BoolType
+class BoolType {
+public:
+    explicit BoolType(bool value = false) : value_(value) {}
+
+    void serialize(Buffer& buffer) const {
+        buffer.push_back(static_cast<std::byte>(value_ ? 1 : 0));
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (begin == end) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        value_ = *begin != std::byte{0};
+        return begin + 1;
+    }
+
+    bool getValue() const { return value_; }
+
+    size_t memoryFootprint() const { return sizeof(*this); }
+
+    bool operator==(const BoolType&) const = default;
+
+private:
+    bool value_;
+};
+
+// Упакованный вектор булевых значений: число бит, затем слова по 64 бита в little-endian
+class BitsetType {
+public:
+    BitsetType() = default;
+
+    explicit BitsetType(const std::vector<bool>& values) {
+        for (bool value : values) {
+            push_back(value);
+        }
+    }
+
+    void push_back(bool value) {
+        if (size_ % 64 == 0) {
+            words_.push_back(0);
+        }
+        if (value) {
+            words_.back() |= uint64_t{1} << (size_ % 64);
+        }
+        ++size_;
+    }
+
+    void set(uint64_t index, bool value) {
+        checkIndex(index);
+        uint64_t mask = uint64_t{1} << (index % 64);
+        words_[index / 64] = value ? (words_[index / 64] | mask) : (words_[index / 64] & ~mask);
+    }
+
+    bool test(uint64_t index) const {
+        checkIndex(index);
+        return (words_[index / 64] >> (index % 64)) & 1;
+    }
+
+    uint64_t size() const { return size_; }
+
+    uint64_t count() const {
+        return bits::popcount(reinterpret_cast<const std::byte*>(words_.data()), words_.size());
+    }
+
+    BitsetType& operator&=(const BitsetType& other) {
+        checkSameSize(other);
+        auto data = reinterpret_cast<std::byte*>(words_.data());
+        bits::andWords(data, reinterpret_cast<const std::byte*>(other.words_.data()), data, words_.size());
+        return *this;
+    }
+
+    BitsetType& operator|=(const BitsetType& other) {
+        checkSameSize(other);
+        auto data = reinterpret_cast<std::byte*>(words_.data());
+        bits::orWords(data, reinterpret_cast<const std::byte*>(other.words_.data()), data, words_.size());
+        return *this;
+    }
+
+    const std::vector<uint64_t>& getWords() const { return words_; }
+
+    void serialize(Buffer& buffer) const {
+        auto sizeLe = toLittleEndian(size_);
+        buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
+        for (uint64_t word : words_) {
+            auto le = toLittleEndian(word);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        }
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (std::distance(begin, end) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        bits::View view = bits::View::fromPayload(&(*begin), static_cast<size_t>(std::distance(begin, end)));
+        // Иначе равные битсеты имели бы разные кодировки
+        if (!view.trailingBitsClear()) {
+            throw std::runtime_error("Bitset has bits set past its size");
+        }
+        size_ = view.bitCount;
+        words_.resize(view.wordCount());
+        for (size_t i = 0; i < words_.size(); ++i) {
+            words_[i] = fromLittleEndian<uint64_t>(view.words + i * 8);
+        }
+        return begin + sizeof(uint64_t) + words_.size() * 8;
+    }
+
+    size_t memoryFootprint() const { return sizeof(*this) + words_.capacity() * sizeof(uint64_t); }
+
+    bool operator==(const BitsetType&) const = default;
+
+private:
+    // Биты последнего слова за size_ должны оставаться нулевыми: на них опираются count и сравнение
+    void checkIndex(uint64_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("Bitset index out of range");
+        }
+    }
+
+    void checkSameSize(const BitsetType& other) const {
+        if (other.size_ != size_) {
+            throw std::runtime_error("Bitset size mismatch");
+        }
+    }
+
+    std::vector<uint64_t> words_;
+    uint64_t size_ = 0;
+};
+
+// Тип элементов тензора
+enum class DType : uint64_t {
+    Uint8,
+    Int32,
+    Int64,
+    Uint64,
+    Float32,
+    Float64
+};
+
+inline size_t dtypeSize(DType dtype) {
+    switch (dtype) {
+        case DType::Uint8: return 1;
+        case DType::Int32: return 4;
+        case DType::Float32: return 4;
+        case DType::Int64: return 8;
+        case DType::Uint64: return 8;
+        case DType::Float64: return 8;
+    }
+    throw std::runtime_error("Unknown tensor dtype");
+}
+
+template<typename T>
+constexpr DType dtypeOf() {
+    if constexpr (std::is_same_v<T, uint8_t>) return DType::Uint8;
+    else if constexpr (std::is_same_v<T, int32_t>) return DType::Int32;
+    else if constexpr (std::is_same_v<T, int64_t>) return DType::Int64;
+    else if constexpr (std::is_same_v<T, uint64_t>) return DType::Uint64;
+    else if constexpr (std::is_same_v<T, float>) return DType::Float32;
+    else {
+        static_assert(std::is_same_v<T, double>, "Unsupported tensor element type");
+        return DType::Float64;
+    }
+}
+
+// Типизированный взгляд на данные тензора; шаги в элементах
+template<typename T>
+class TensorView {
+public:
+    TensorView(const T* data, std::vector<uint64_t> shape, std::vector<uint64_t> strides)
+        : data_(data), shape_(std::move(shape)), strides_(std::move(strides)) {}
+
+    const T* data() const { return data_; }
+    const std::vector<uint64_t>& shape() const { return shape_; }
+    const std::vector<uint64_t>& strides() const { return strides_; }
+
+    template<typename... Index>
+    const T& operator()(Index... index) const {
+        if (sizeof...(Index) != shape_.size()) {
+            throw std::runtime_error("Tensor rank mismatch");
+        }
+        const uint64_t indices[] = {static_cast<uint64_t>(index)...};
+        uint64_t offset = 0;
+        for (size_t i = 0; i < shape_.size(); ++i) {
+            if (indices[i] >= shape_[i]) {
+                throw std::out_of_range("Tensor index out of range");
+            }
+            offset += indices[i] * strides_[i];
+        }
+        return data_[offset];
+    }
+
+private:
+    const T* data_;
+    std::vector<uint64_t> shape_;
+    std::vector<uint64_t> strides_;
+};
+
+// Заголовок тензора в закодированном буфере: dtype, ранг, форма, шаги, длина данных, выравнивание.
+// Данные начинаются на границе kTensorAlignment от начала полезной нагрузки, так что кодировка
+// не зависит от того, где в буфере оказался тензор.
+struct TensorLayout {
+    static constexpr size_t kTensorAlignment = 64;
+    static constexpr uint64_t kMaxRank = 32;
+
+    DType dtype = DType::Float64;
+    std::vector<uint64_t> shape;
+    std::vector<uint64_t> strides;
+    uint64_t dataBytes = 0;
+    size_t headerBytes = 0;   // от начала полезной нагрузки до данных
+
+    // Разбор и проверка: каждый адресуемый элемент лежит внутри блока данных
+    static TensorLayout parse(const std::byte* data, size_t size) {
+        TensorLayout layout;
+        size_t pos = 0;
+        auto read = [&]() {
+            if (size - pos < sizeof(uint64_t)) {
+                throw std::runtime_error("Not enough data for deserialization");
+            }
+            uint64_t value = fromLittleEndian<uint64_t>(data + pos);
+            pos += sizeof(uint64_t);
+            return value;
+        };
+        layout.dtype = static_cast<DType>(read());
+        size_t elementSize = dtypeSize(layout.dtype);
+        uint64_t rank = read();
+        if (rank > kMaxRank) {
+            throw std::runtime_error("Tensor rank too large");
+        }
+        for (uint64_t i = 0; i < rank; ++i) {
+            layout.shape.push_back(read());
+        }
+        for (uint64_t i = 0; i < rank; ++i) {
+            layout.strides.push_back(read());
+        }
+        layout.dataBytes = read();
+        uint64_t padding = read();
+        if (padding >= kTensorAlignment || size - pos < padding || size - pos - padding < layout.dataBytes ||
+            layout.dataBytes % elementSize != 0) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        layout.headerBytes = pos + static_cast<size_t>(padding);
+
+        uint64_t elements = layout.dataBytes / elementSize;
+        uint64_t last = 0;
+        for (size_t i = 0; i < rank; ++i) {
+            if (layout.shape[i] == 0) {
+                return layout;
+            }
+            if (layout.strides[i] != 0 && layout.shape[i] - 1 > (UINT64_MAX - last) / layout.strides[i]) {
+                throw std::runtime_error("Tensor strides overflow");
+            }
+            last += (layout.shape[i] - 1) * layout.strides[i];
+        }
+        if (last >= elements) {
+            throw std::runtime_error("Tensor strides exceed data block");
+        }
+        return layout;
+    }
+
+    static std::vector<uint64_t> contiguousStrides(const std::vector<uint64_t>& shape) {
+        std::vector<uint64_t> strides(shape.size());
+        uint64_t stride = 1;
+        for (size_t i = shape.size(); i-- > 0;) {
+            strides[i] = stride;
+            stride *= shape[i];
+        }
+        return strides;
+    }
+};
+
+// Выделяет память с заданным выравниванием; данные тензора лежат на границе кэш-линии
+template<typename T, size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template<typename U>
+    struct rebind {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(size_t count) {
+        if (count > SIZE_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* ptr, size_t) noexcept { ::operator delete(ptr, std::align_val_t(Alignment)); }
+
+    template<typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+};
+
+// N-мерный тензор: одна непрерывная область данных вместо дерева Any
+class TensorType {
+public:
+    TensorType() = default;
+
+    TensorType(DType dtype, std::vector<uint64_t> shape) : dtype_(dtype), shape_(std::move(shape)) {
+        strides_ = TensorLayout::contiguousStrides(shape_);
+        uint64_t count = 1;
+        for (uint64_t dim : shape_) {
+            if (dim != 0 && count > UINT64_MAX / dim) {
+                throw std::length_error("Tensor shape is too large");
+            }
+            count *= dim;
+        }
+        if (count > data_.max_size() / dtypeSize(dtype_)) {
+            throw std::length_error("Tensor shape is too large");
+        }
+        data_.resize(static_cast<size_t>(count * dtypeSize(dtype_)));
+    }
+
+    template<typename T>
+    static TensorType fromData(std::vector<uint64_t> shape, const T* values) {
+        TensorType tensor(dtypeOf<T>(), std::move(shape));
+        if (!tensor.data_.empty()) {
+            std::memcpy(tensor.data_.data(), values, tensor.data_.size());
+        }
+        return tensor;
+    }
+
+    DType getDType() const { return dtype_; }
+    const std::vector<uint64_t>& getShape() const { return shape_; }
+    const std::vector<uint64_t>& getStrides() const { return strides_; }
+
+    template<typename T>
+    TensorView<T> view() const {
+        return TensorView<T>(typedData<T>(), shape_, strides_);
+    }
+
+    // Непрерывные данные для заполнения на месте
+    template<typename T>
+    T* mutableData() {
+        return const_cast<T*>(typedData<T>());
+    }
+
+    void serialize(Buffer& buffer) const {
+        auto put = [&buffer](uint64_t value) {
+            auto le = toLittleEndian(value);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        };
+        size_t payloadStart = buffer.size();
+        put(static_cast<uint64_t>(dtype_));
+        put(shape_.size());
+        for (uint64_t dim : shape_) put(dim);
+        for (uint64_t stride : strides_) put(stride);
+        put(data_.size());
+        size_t dataStart = buffer.size() + sizeof(uint64_t) - payloadStart;
+        size_t padding = (TensorLayout::kTensorAlignment - dataStart % TensorLayout::kTensorAlignment) %
+                         TensorLayout::kTensorAlignment;
+        put(padding);
+        buffer.resize(buffer.size() + padding);
+        size_t at = buffer.size();
+        buffer.resize(at + data_.size());
+        if constexpr (std::endian::native == std::endian::little) {
+            std::memcpy(buffer.data() + at, data_.data(), data_.size());
+        } else {
+            copySwapped(data_.data(), buffer.data() + at, data_.size(), dtypeSize(dtype_));
+        }
+    }
+
+    // Данные копируются одним memcpy, поэлементной работы нет
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (begin == end) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        TensorLayout layout = TensorLayout::parse(&(*begin), static_cast<size_t>(std::distance(begin, end)));
+        dtype_ = layout.dtype;
+        shape_ = std::move(layout.shape);
+        strides_ = std::move(layout.strides);
+        const std::byte* source = &(*begin) + layout.headerBytes;
+        if constexpr (std::endian::native == std::endian::little) {
+            data_.assign(source, source + layout.dataBytes);
+        } else {
+            data_.resize(layout.dataBytes);
+            copySwapped(source, data_.data(), data_.size(), dtypeSize(dtype_));
+        }
+        return begin + layout.headerBytes + layout.dataBytes;
+    }
+
+    // Тензор прямо в закодированном буфере, без копирования (только little-endian и при выравнивании)
+    template<typename T>
+    static TensorView<T> viewPayload(const std::byte* payload, size_t size) {
+        TensorLayout layout = TensorLayout::parse(payload, size);
+        if (layout.dtype != dtypeOf<T>()) {
+            throw std::runtime_error("Tensor dtype mismatch");
+        }
+        const std::byte* data = payload + layout.headerBytes;
+        if (std::endian::native != std::endian::little || reinterpret_cast<uintptr_t>(data) % alignof(T) != 0) {
+            throw std::runtime_error("Tensor data cannot be viewed in place");
+        }
+        return TensorView<T>(reinterpret_cast<const T*>(data), std::move(layout.shape), std::move(layout.strides));
+    }
+
+    size_t memoryFootprint() const {
+        return sizeof(*this) + (shape_.capacity() + strides_.capacity()) * sizeof(uint64_t) + data_.capacity();
+    }
+
+    bool operator==(const TensorType&) const = default;
+
+private:
+    template<typename T>
+    const T* typedData() const {
+        if (dtypeOf<T>() != dtype_) {
+            throw std::runtime_error("Tensor dtype mismatch");
+        }
+        return reinterpret_cast<const T*>(data_.data());
+    }
+
+    static void copySwapped(const std::byte* from, std::byte* to, size_t bytes, size_t elementSize) {
+        for (size_t i = 0; i < bytes; i += elementSize) {
+            std::reverse_copy(from + i, from + i + elementSize, to + i);
+        }
+    }
+
+    DType dtype_ = DType::Float64;
+    std::vector<uint64_t> shape_;
+    std::vector<uint64_t> strides_;
+    std::vector<std::byte, AlignedAllocator<std::byte, TensorLayout::kTensorAlignment>> data_;
+};
+
+// Разреженные векторы: логическая длина, число ненулевых, индексы дельтами в LEB128, затем значения по 8 байт.
+// Ядра sparse::View работают прямо по закодированным байтам, стоимость растёт с числом ненулевых.
+namespace sparse {
+
+inline void putVarint(Buffer& buffer, uint64_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<std::byte>(value));
+}
+
+inline uint64_t getVarint(const std::byte*& pos, const std::byte* end) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (pos == end) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        auto byte = static_cast<uint64_t>(*pos++);
+        value |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Malformed varint");
+}
+
+inline double asDouble(uint64_t raw) {
+    double value;
+    std::memcpy(&value, &raw, sizeof(value));
+    return value;
+}
+
+class View {
+public:
+    // Последовательный обход пар (индекс, значение)
+    class Cursor {
+    public:
+        bool valid() const { return remaining_ > 0; }
+        uint64_t index() const { return index_; }
+        uint64_t raw() const { return fromLittleEndian<uint64_t>(value_); }
+
+        void next() {
+            if (--remaining_ > 0) {
+                index_ += getVarint(indices_, indicesEnd_);
+                value_ += sizeof(uint64_t);
+            }
+        }
+
+    private:
+        friend class View;
+
+        const std::byte* indices_;
+        const std::byte* indicesEnd_;
+        const std::byte* value_;
+        uint64_t remaining_;
+        uint64_t index_ = 0;
+    };
+
+    // data указывает на полезную нагрузку SparseVectorType (после тега); структура проверяется целиком
+    static View fromPayload(const std::byte* data, size_t size) {
+        if (size < 4 * sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        View view;
+        view.valueType_ = static_cast<TypeId>(fromLittleEndian<uint64_t>(data));
+        view.length_ = fromLittleEndian<uint64_t>(data + 8);
+        view.nonZeros_ = fromLittleEndian<uint64_t>(data + 16);
+        uint64_t indexBytes = fromLittleEndian<uint64_t>(data + 24);
+        if (view.valueType_ != TypeId::Uint && view.valueType_ != TypeId::Float) {
+            throw std::runtime_error("Sparse vector values must be Uint or Float");
+        }
+        size_t rest = size - 4 * sizeof(uint64_t);
+        if (indexBytes > rest || view.nonZeros_ > (rest - indexBytes) / sizeof(uint64_t) ||
+            view.nonZeros_ > indexBytes || view.nonZeros_ > view.length_) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        view.indices_ = data + 4 * sizeof(uint64_t);
+        view.values_ = view.indices_ + indexBytes;
+        view.payloadSize_ = 4 * sizeof(uint64_t) + indexBytes + view.nonZeros_ * sizeof(uint64_t);
+
+        const std::byte* pos = view.indices_;
+        uint64_t index = 0;
+        for (uint64_t i = 0; i < view.nonZeros_; ++i) {
+            uint64_t delta = getVarint(pos, view.values_);
+            if ((i > 0 && delta == 0) || delta >= view.length_ - index) {
+                throw std::runtime_error("Sparse vector indices out of order or range");
+            }
+            index += delta;
+        }
+        if (pos != view.values_) {
+            throw std::runtime_error("Sparse vector index block has trailing bytes");
+        }
+        return view;
+    }
+
+    TypeId valueType() const { return valueType_; }
+    uint64_t length() const { return length_; }
+    uint64_t nonZeros() const { return nonZeros_; }
+    size_t payloadSize() const { return payloadSize_; }
+
+    Cursor begin() const {
+        Cursor cursor;
+        cursor.indices_ = indices_;
+        cursor.indicesEnd_ = values_;
+        cursor.value_ = values_;
+        cursor.remaining_ = nonZeros_;
+        if (nonZeros_ > 0) {
+            cursor.index_ = getVarint(cursor.indices_, cursor.indicesEnd_);
+        }
+        return cursor;
+    }
+
+    // Значение как double независимо от типа значений
+    double valueAsDouble(const Cursor& cursor) const {
+        return valueType_ == TypeId::Float ? asDouble(cursor.raw()) : static_cast<double>(cursor.raw());
+    }
+
+    double sum() const {
+        double total = 0.0;
+        if (valueType_ == TypeId::Float) {
+            for (uint64_t i = 0; i < nonZeros_; ++i) {
+                total += asDouble(fromLittleEndian<uint64_t>(values_ + i * sizeof(uint64_t)));
+            }
+        } else {
+            for (uint64_t i = 0; i < nonZeros_; ++i) {
+                total += static_cast<double>(fromLittleEndian<uint64_t>(values_ + i * sizeof(uint64_t)));
+            }
+        }
+        return total;
+    }
+
+    // Скалярное произведение с плотным вектором длины length()
+    double dot(const double* dense, size_t size) const {
+        if (size != length_) {
+            throw std::runtime_error("Sparse vector length mismatch");
+        }
+        double total = 0.0;
+        for (Cursor c = begin(); c.valid(); c.next()) {
+            total += valueAsDouble(c) * dense[c.index()];
+        }
+        return total;
+    }
+
+    // Скалярное произведение двух разреженных векторов слиянием индексов
+    double dot(const View& other) const {
+        if (other.length_ != length_) {
+            throw std::runtime_error("Sparse vector length mismatch");
+        }
+        double total = 0.0;
+        Cursor a = begin();
+        Cursor b = other.begin();
+        while (a.valid() && b.valid()) {
+            if (a.index() < b.index()) {
+                a.next();
+            } else if (b.index() < a.index()) {
+                b.next();
+            } else {
+                total += valueAsDouble(a) * other.valueAsDouble(b);
+                a.next();
+                b.next();
+            }
+        }
+        return total;
+    }
+
+private:
+    TypeId valueType_ = TypeId::Float;
+    uint64_t length_ = 0;
+    uint64_t nonZeros_ = 0;
+    const std::byte* indices_ = nullptr;
+    const std::byte* values_ = nullptr;
+    size_t payloadSize_ = 0;
+};
+
+} // namespace sparse
+
+// Разреженный вектор значений IntegerType или FloatType; хранятся только ненулевые
+class SparseVectorType {
+public:
+    explicit SparseVectorType(TypeId valueType = TypeId::Float, uint64_t length = 0)
+        : valueType_(valueType), length_(length) {
+        if (valueType_ != TypeId::Uint && valueType_ != TypeId::Float) {
+            throw std::runtime_error("Sparse vector values must be Uint or Float");
+        }
+    }
+
+    // Индексы добавляются строго по возрастанию; не хранятся только значения из нулевых битов,
+    // поэтому -0.0 сохраняется. Имена раздельные: перегрузка push_back(i, 1) была неоднозначной
+    void push_uint(uint64_t index, uint64_t value) {
+        checkType(TypeId::Uint);
+        append(index, value);
+    }
+
+    void push_float(uint64_t index, double value) {
+        checkType(TypeId::Float);
+        append(index, std::bit_cast<uint64_t>(value));
+    }
+
+    TypeId getValueType() const { return valueType_; }
+    uint64_t size() const { return length_; }
+    uint64_t nonZeros() const { return indices_.size(); }
+    const std::vector<uint64_t>& getIndices() const { return indices_; }
+
+    // Плотное представление по запросу: uint64_t для Uint, double для Float
+    template<typename T>
+    std::vector<T> toDense() const {
+        static_assert(std::is_same_v<T, uint64_t> || std::is_same_v<T, double>, "Uint or Float values only");
+        checkType(std::is_same_v<T, double> ? TypeId::Float : TypeId::Uint);
+        std::vector<T> dense(length_);
+        for (size_t i = 0; i < indices_.size(); ++i) {
+            std::memcpy(&dense[indices_[i]], &values_[i], sizeof(T));
+        }
+        return dense;
+    }
+
+    void serialize(Buffer& buffer) const {
+        Buffer indexBytes;
+        uint64_t previous = 0;
+        for (uint64_t index : indices_) {
+            sparse::putVarint(indexBytes, index - previous);
+            previous = index;
+        }
+        for (uint64_t field : {static_cast<uint64_t>(valueType_), length_, static_cast<uint64_t>(indices_.size()),
+                               static_cast<uint64_t>(indexBytes.size())}) {
+            auto le = toLittleEndian(field);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        }
+        buffer.insert(buffer.end(), indexBytes.begin(), indexBytes.end());
+        for (uint64_t value : values_) {
+            auto le = toLittleEndian(value);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        }
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (begin == end) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        sparse::View view = sparse::View::fromPayload(&(*begin), static_cast<size_t>(std::distance(begin, end)));
+        valueType_ = view.valueType();
+        length_ = view.length();
+        indices_.clear();
+        values_.clear();
+        indices_.reserve(view.nonZeros());
+        values_.reserve(view.nonZeros());
+        for (auto c = view.begin(); c.valid(); c.next()) {
+            indices_.push_back(c.index());
+            values_.push_back(c.raw());
+        }
+        return begin + view.payloadSize();
+    }
+
+    size_t memoryFootprint() const {
+        return sizeof(*this) + (indices_.capacity() + values_.capacity()) * sizeof(uint64_t);
+    }
+
+    bool operator==(const SparseVectorType&) const = default;
+
+private:
+    void checkType(TypeId type) const {
+        if (type != valueType_) {
+            throw std::runtime_error("Sparse vector value type mismatch");
+        }
+    }
+
+    void append(uint64_t index, uint64_t raw) {
+        if (index >= length_ || (!indices_.empty() && index <= indices_.back())) {
+            throw std::runtime_error("Sparse vector indices must be increasing and within length");
+        }
+        if (raw == 0) {
+            return;
+        }
+        indices_.push_back(index);
+        values_.push_back(raw);
+    }
+
+    TypeId valueType_;
+    uint64_t length_;
+    std::vector<uint64_t> indices_;
+    std::vector<uint64_t> values_;  // сырые 8 байт: uint64_t или биты double
+};
+
+// Метка времени с точностью до наносекунды (от эпохи Unix)
+class TimestampType {
+public:
+    explicit TimestampType(int64_t nanoseconds = 0) : value_(nanoseconds) {}
+
+    void serialize(Buffer& buffer) const {
+        auto le = toLittleEndian(static_cast<uint64_t>(value_));
+        buffer.insert(buffer.end(), le.begin(), le.end());
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (std::distance(begin, end) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        value_ = static_cast<int64_t>(fromLittleEndian<uint64_t>(&(*begin)));
+        return begin + sizeof(uint64_t);
+    }
+
+    int64_t getValue() const { return value_; }
+
+    size_t memoryFootprint() const { return sizeof(*this); }
+
+    bool operator==(const TimestampType&) const = default;
+
+private:
+    int64_t value_;
+};
+
+// Битовый поток для delta-of-delta: биты пишутся от младших к старшим, слова little-endian
+namespace bitstream {
+
+class Writer {
+public:
+    explicit Writer(Buffer& out) : out_(out) {}
+
+    void put(uint64_t value, unsigned bits) {
+        if (bits < 64) {
+            value &= (uint64_t{1} << bits) - 1;
+        }
+        acc_ |= value << used_;
+        if (used_ + bits >= 64) {
+            flushWord();
+            acc_ = used_ == 0 ? 0 : value >> (64 - used_);
+            used_ = used_ + bits - 64;
+        } else {
+            used_ += bits;
+        }
+    }
+
+    void finish() {
+        auto le = toLittleEndian(acc_);
+        out_.insert(out_.end(), le.begin(), le.begin() + (used_ + 7) / 8);
+        acc_ = 0;
+        used_ = 0;
+    }
+
+private:
+    void flushWord() {
+        auto le = toLittleEndian(acc_);
+        out_.insert(out_.end(), le.begin(), le.end());
+    }
+
+    Buffer& out_;
+    uint64_t acc_ = 0;
+    unsigned used_ = 0;
+};
+
+class Reader {
+public:
+    Reader(const std::byte* data, size_t size) : data_(data), size_(size) {}
+
+    uint64_t get(unsigned bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        if (bits > size_ * 8 - pos_) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        size_t byte = pos_ / 8;
+        unsigned shift = static_cast<unsigned>(pos_ % 8);
+        uint64_t value = load(byte) >> shift;
+        if (shift != 0 && bits > 64 - shift) {
+            value |= load(byte + 8) << (64 - shift);
+        }
+        pos_ += bits;
+        return bits == 64 ? value : value & ((uint64_t{1} << bits) - 1);
+    }
+
+    // Следующие 64 бита без продвижения; за концом потока нули
+    uint64_t peek() const {
+        size_t byte = pos_ / 8;
+        unsigned shift = static_cast<unsigned>(pos_ % 8);
+        uint64_t value = load(byte) >> shift;
+        if (shift != 0) {
+            value |= load(byte + 8) << (64 - shift);
+        }
+        return value;
+    }
+
+    void skip(size_t bits) {
+        if (bits > size_ * 8 - pos_) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        pos_ += bits;
+    }
+
+    // Writer::finish дописывает только неполный последний байт, добивая его нулями
+    bool atCanonicalEnd() const {
+        if ((pos_ + 7) / 8 != size_) {
+            return false;
+        }
+        return pos_ % 8 == 0 || (static_cast<unsigned>(data_[size_ - 1]) >> (pos_ % 8)) == 0;
+    }
+
+private:
+    uint64_t load(size_t byte) const {
+        if (byte + 8 <= size_) {
+            return fromLittleEndian<uint64_t>(data_ + byte);
+        }
+        std::byte tail[8] = {};
+        if (byte < size_) {
+            std::copy(data_ + byte, data_ + size_, tail);
+        }
+        return fromLittleEndian<uint64_t>(tail);
+    }
+
+    const std::byte* data_;
+    size_t size_;
+    size_t pos_ = 0;
+};
+
+} // namespace bitstream
+
+// Вектор меток времени. Кодируется как число значений, первое значение, длина битового потока и поток:
+// для каждой следующей метки — delta-of-delta в zigzag, корзины по префиксу
+//   0 -> 0, 10 -> 7 бит, 110 -> 9 бит, 1110 -> 12 бит, 11110 -> 32 бита, 11111 -> 64 бита.
+// Равномерный ряд стоит один бит на метку.
+class TimestampVectorType {
+public:
+    TimestampVectorType() = default;
+
+    explicit TimestampVectorType(std::vector<int64_t> values) : values_(std::move(values)) {}
+
+    void push_back(int64_t nanoseconds) { values_.push_back(nanoseconds); }
+
+    const std::vector<int64_t>& getValues() const { return values_; }
+
+    void serialize(Buffer& buffer) const {
+        Buffer stream;
+        bitstream::Writer writer(stream);
+        uint64_t previousDelta = 0;
+        for (size_t i = 1; i < values_.size(); ++i) {
+            uint64_t delta = static_cast<uint64_t>(values_[i]) - static_cast<uint64_t>(values_[i - 1]);
+            auto dod = static_cast<int64_t>(delta - previousDelta);
+            uint64_t zigzag = (static_cast<uint64_t>(dod) << 1) ^ static_cast<uint64_t>(dod >> 63);
+            previousDelta = delta;
+            if (zigzag == 0) {
+                writer.put(0b0, 1);
+                continue;
+            }
+            unsigned bucket = 0;
+            while (bucket + 1 < kBucketBits.size() && zigzag >> kBucketBits[bucket] != 0) {
+                ++bucket;
+            }
+            // Префикс: bucket+1 единиц и ноль, у последней корзины ноля нет
+            unsigned ones = bucket + 1;
+            writer.put((uint64_t{1} << ones) - 1, ones);
+            if (ones < kBucketBits.size()) {
+                writer.put(0, 1);
+            }
+            writer.put(zigzag, kBucketBits[bucket]);
+        }
+        writer.finish();
+
+        for (uint64_t field : {static_cast<uint64_t>(values_.size()),
+                               static_cast<uint64_t>(values_.empty() ? 0 : values_.front()),
+                               static_cast<uint64_t>(stream.size())}) {
+            auto le = toLittleEndian(field);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        }
+        buffer.insert(buffer.end(), stream.begin(), stream.end());
+    }
+
+    // Блочное декодирование полезной нагрузки в out; возвращает число прочитанных байт
+    static size_t decodePayload(const std::byte* data, size_t size, std::vector<int64_t>& out) {
+        if (size < 3 * sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t count = fromLittleEndian<uint64_t>(data);
+        uint64_t first = fromLittleEndian<uint64_t>(data + 8);
+        uint64_t streamBytes = fromLittleEndian<uint64_t>(data + 16);
+        size -= 3 * sizeof(uint64_t);
+        // Каждая метка после первой занимает хотя бы один бит
+        if (streamBytes > size || (count > 0 && count - 1 > streamBytes * 8)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        out.resize(static_cast<size_t>(count));
+        if (count == 0) {
+            if (streamBytes != 0) {
+                throw std::runtime_error("Malformed timestamp vector stream");
+            }
+            return 3 * sizeof(uint64_t);
+        }
+        bitstream::Reader reader(data + 3 * sizeof(uint64_t), static_cast<size_t>(streamBytes));
+        uint64_t value = first;
+        uint64_t delta = 0;
+        out[0] = static_cast<int64_t>(value);
+        for (uint64_t i = 1; i < count;) {
+            uint64_t window = reader.peek();
+            // Серия нулевых delta-of-delta обрабатывается целиком: метки идут с прежним шагом
+            if ((window & 1) == 0) {
+                uint64_t run = std::min<uint64_t>(window == 0 ? 64 : std::countr_zero(window), count - i);
+                reader.skip(run);
+                for (uint64_t end = i + run; i < end; ++i) {
+                    value += delta;
+                    out[i] = static_cast<int64_t>(value);
+                }
+                continue;
+            }
+            unsigned ones = std::min<unsigned>(std::countr_one(window), kBucketBits.size());
+            unsigned prefix = ones + (ones < kBucketBits.size() ? 1 : 0);
+            unsigned bits = kBucketBits[ones - 1];
+            uint64_t zigzag;
+            if (prefix + bits <= 64) {
+                zigzag = (window >> prefix) & ((uint64_t{1} << bits) - 1);
+                reader.skip(prefix + bits);
+            } else {
+                reader.skip(prefix);
+                zigzag = reader.get(bits);
+            }
+            delta += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+            value += delta;
+            out[i++] = static_cast<int64_t>(value);
+        }
+        // Иначе одна последовательность имела бы много кодировок
+        if (!reader.atCanonicalEnd()) {
+            throw std::runtime_error("Malformed timestamp vector stream");
+        }
+        return 3 * sizeof(uint64_t) + static_cast<size_t>(streamBytes);
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (begin == end) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        return begin + decodePayload(&(*begin), static_cast<size_t>(std::distance(begin, end)), values_);
+    }
+
+    size_t memoryFootprint() const { return sizeof(*this) + values_.capacity() * sizeof(int64_t); }
+
+    bool operator==(const TimestampVectorType&) const = default;
+
+private:
+    static constexpr std::array<unsigned, 5> kBucketBits = {7, 9, 12, 32, 64};
+
+    std::vector<int64_t> values_;
+};
+
+// Отсутствующее значение: только тег, без полезной нагрузки
+class NullType {
+public:
+    void serialize(Buffer&) const {}
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator) {
+        return begin;
+    }
+
+    size_t memoryFootprint() const { return sizeof(*this); }
+
+    bool operator==(const NullType&) const = default;
+};
+
+// Однородный столбец Uint/Float с пропусками. Кодируется как тип значений, число пропусков,
+// битовая карта присутствия в формате BitsetType и значения только присутствующих элементов по 8 байт,
+// так что пропуск стоит один бит. Агрегаты nullable::View обходят карту словами.
+namespace nullable {
+
+class View {
+public:
+    // data указывает на полезную нагрузку NullableVectorType (после тега)
+    static View fromPayload(const std::byte* data, size_t size) {
+        if (size < 2 * sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        View view;
+        view.valueType_ = static_cast<TypeId>(fromLittleEndian<uint64_t>(data));
+        view.nullCount_ = fromLittleEndian<uint64_t>(data + 8);
+        if (view.valueType_ != TypeId::Uint && view.valueType_ != TypeId::Float) {
+            throw std::runtime_error("Nullable vector values must be Uint or Float");
+        }
+        view.validity_ = bits::View::fromPayload(data + 16, size - 16);
+        size_t bitmapBytes = sizeof(uint64_t) + view.validity_.wordCount() * 8;
+        size_t rest = size - 16 - bitmapBytes;
+        if (view.nullCount_ > view.validity_.bitCount || !view.validity_.trailingBitsClear() ||
+            view.validity_.count() != view.validity_.bitCount - view.nullCount_ ||
+            view.validCount() > rest / sizeof(uint64_t)) {
+            throw std::runtime_error("Nullable vector validity bitmap is inconsistent");
+        }
+        view.values_ = data + 16 + bitmapBytes;
+        view.payloadSize_ = 16 + bitmapBytes + static_cast<size_t>(view.validCount()) * sizeof(uint64_t);
+        return view;
+    }
+
+    TypeId valueType() const { return valueType_; }
+    uint64_t length() const { return validity_.bitCount; }
+    uint64_t nullCount() const { return nullCount_; }
+    uint64_t validCount() const { return validity_.bitCount - nullCount_; }
+    size_t payloadSize() const { return payloadSize_; }
+    const bits::View& validity() const { return validity_; }
+
+    uint64_t raw(uint64_t rank) const { return fromLittleEndian<uint64_t>(values_ + rank * sizeof(uint64_t)); }
+
+    double valueAsDouble(uint64_t rank) const {
+        uint64_t bits = raw(rank);
+        if (valueType_ == TypeId::Uint) {
+            return static_cast<double>(bits);
+        }
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // f(индекс, ранг среди присутствующих) для каждого присутствующего элемента; пустые слова пропускаются
+    template<typename F>
+    void forEachValid(F&& f) const {
+        uint64_t rank = 0;
+        for (size_t w = 0; w < validity_.wordCount(); ++w) {
+            uint64_t word = fromLittleEndian<uint64_t>(validity_.words + w * 8);
+            while (word != 0) {
+                f(w * 64 + static_cast<uint64_t>(std::countr_zero(word)), rank++);
+                word &= word - 1;
+            }
+        }
+    }
+
+    // Пропуски не хранятся, поэтому сумма не проверяет их вовсе
+    double sum() const {
+        double total = 0.0;
+        for (uint64_t i = 0; i < validCount(); ++i) {
+            total += valueAsDouble(i);
+        }
+        return total;
+    }
+
+    double mean() const {
+        return validCount() ? sum() / static_cast<double>(validCount()) : 0.0;
+    }
+
+    // Скалярное произведение по позициям, присутствующим в обоих столбцах (AND карт по словам)
+    double dot(const View& other) const {
+        if (other.length() != length()) {
+            throw std::runtime_error("Nullable vector length mismatch");
+        }
+        double total = 0.0;
+        uint64_t rankA = 0;
+        uint64_t rankB = 0;
+        for (size_t w = 0; w < validity_.wordCount(); ++w) {
+            uint64_t a = fromLittleEndian<uint64_t>(validity_.words + w * 8);
+            uint64_t b = fromLittleEndian<uint64_t>(other.validity_.words + w * 8);
+            for (uint64_t both = a & b; both != 0; both &= both - 1) {
+                uint64_t below = (both & (~both + 1)) - 1;
+                total += valueAsDouble(rankA + std::popcount(a & below)) *
+                         other.valueAsDouble(rankB + std::popcount(b & below));
+            }
+            rankA += std::popcount(a);
+            rankB += std::popcount(b);
+        }
+        return total;
+    }
+
+private:
+    TypeId valueType_ = TypeId::Float;
+    uint64_t nullCount_ = 0;
+    bits::View validity_;
+    const std::byte* values_ = nullptr;
+    size_t payloadSize_ = 0;
+};
+
+} // namespace nullable
+
+class NullableVectorType {
+public:
+    explicit NullableVectorType(TypeId valueType = TypeId::Float) : valueType_(valueType) {
+        if (valueType_ != TypeId::Uint && valueType_ != TypeId::Float) {
+            throw std::runtime_error("Nullable vector values must be Uint or Float");
+        }
+    }
+
+    // Имена раздельные: перегрузка push_back(1) была неоднозначной
+    void push_uint(uint64_t value) {
+        checkType(TypeId::Uint);
+        validity_.push_back(true);
+        values_.push_back(value);
+    }
+
+    void push_float(double value) {
+        checkType(TypeId::Float);
+        validity_.push_back(true);
+        values_.push_back(std::bit_cast<uint64_t>(value));
+    }
+
+    void push_null() { validity_.push_back(false); }
+
+    TypeId getValueType() const { return valueType_; }
+    uint64_t size() const { return validity_.size(); }
+    uint64_t nullCount() const { return validity_.size() - values_.size(); }
+    bool isNull(uint64_t index) const { return !validity_.test(index); }
+    const BitsetType& getValidity() const { return validity_; }
+
+    // Значения присутствующих элементов по порядку (сырые 8 байт: uint64_t или биты double)
+    const std::vector<uint64_t>& getValues() const { return values_; }
+
+    void serialize(Buffer& buffer) const {
+        for (uint64_t field : {static_cast<uint64_t>(valueType_), nullCount()}) {
+            auto le = toLittleEndian(field);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        }
+        validity_.serialize(buffer);
+        for (uint64_t value : values_) {
+            auto le = toLittleEndian(value);
+            buffer.insert(buffer.end(), le.begin(), le.end());
+        }
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (begin == end) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        nullable::View view = nullable::View::fromPayload(&(*begin), static_cast<size_t>(std::distance(begin, end)));
+        valueType_ = view.valueType();
+        validity_.deserialize(begin + 16, end);
+        values_.resize(static_cast<size_t>(view.validCount()));
+        for (size_t i = 0; i < values_.size(); ++i) {
+            values_[i] = view.raw(i);
+        }
+        return begin + view.payloadSize();
+    }
+
+    size_t memoryFootprint() const {
+        return sizeof(*this) - sizeof(validity_) + validity_.memoryFootprint() +
+               values_.capacity() * sizeof(uint64_t);
+    }
+
+    bool operator==(const NullableVectorType&) const = default;
+
+private:
+    void checkType(TypeId type) const {
+        if (type != valueType_) {
+            throw std::runtime_error("Nullable vector value type mismatch");
+        }
+    }
+
+    TypeId valueType_;
+    BitsetType validity_;
+    std::vector<uint64_t> values_;
+};
+
+// Число подряд идущих элементов (не больше limit) с тем же 8-байтовым тегом, что у первого, при шаге
+// 16 байт — так лежат серии Uint или Float. Сравниваются сырые слова, порядок байт не важен.
+inline size_t scalarRunLength(const std::byte* data, size_t limit) {
+    uint64_t tag;
+    std::memcpy(&tag, data, sizeof(tag));
+    size_t count = 0;
+#ifdef __AVX2__
+    // Четыре элемента за шаг: теги в чётных 64-битных дорожках двух 256-битных загрузок
+    const __m256i pattern = _mm256_set1_epi64x(static_cast<int64_t>(tag));
+    for (; count + 4 <= limit; count += 4) {
+        const std::byte* at = data + count * 16;
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(at));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(at + 32));
+        int low = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(first, pattern)));
+        int high = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(second, pattern)));
+        if ((low & high & 0b0101) != 0b0101) {
+            break;
+        }
+    }
+#endif
+    for (; count < limit; ++count) {
+        uint64_t word;
+        std::memcpy(&word, data + count * 16, sizeof(word));
+        if (word != tag) {
+            break;
+        }
+    }
+    return count;
+}
+
+class Any;
+
+// Число элементов, вместо которого идут блоки [n][n элементов]..., завершаемые блоком с n = 0.
+// Так пишутся последовательности заранее неизвестной длины (см. StreamEncoder); годится и для корня.
+constexpr uint64_t kChunkedCount = UINT64_MAX;
+
+// Декодирует count элементов подряд в out; определена после Any
+inline Buffer::const_iterator decodeElements(std::vector<Any>& out, uint64_t count, Buffer::const_iterator begin,
+                                             Buffer::const_iterator end);
+
+// Память дерева: сам вектор, его буфер элементов (включая запас capacity) и куча вложенных значений
+inline size_t memoryFootprint(const std::vector<Any>& elements);
+
+// Контейнерный тип VectorType
+class VectorType {
+public:
+    VectorType() = default;
+
+    explicit VectorType(std::vector<Any> elements) : elements_(std::move(elements)) {}
+
+    template<typename Arg>
+    void push_back(Arg&& val) {
+        elements_.emplace_back(std::forward<Arg>(val));
+    }
+
+    // Методы, которым нужен полный тип Any, определены после него
+    void serialize(Buffer& buffer) const;
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end);
+
+    const std::vector<Any>& getElements() const { return elements_; }
+
+    size_t memoryFootprint() const;
+
+    bool operator==(const VectorType&) const = default;
+
+private:
+    std::vector<Any> elements_;
+};
+
+// Универсальный тип Any
+class Any {
+public:
+    // Копирование и перемещение Any не должны попадать в конструктор полезной нагрузки
+    template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Any>>>
+    explicit Any(T&& value) : payload_(std::forward<T>(value)) {}
+
+    void serialize(Buffer& buffer) const {
+        std::visit([&buffer](auto&& arg) {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, IntegerType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Uint));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, FloatType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Float));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, StringType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::String));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, VectorType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Vector));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, BoolType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Bool));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, BitsetType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Bitset));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, TensorType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Tensor));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, SparseVectorType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::SparseVector));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, TimestampType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Timestamp));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, TimestampVectorType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::TimestampVector));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, NullType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::Null));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            } else if constexpr (std::is_same_v<T, NullableVectorType>) {
+                auto tagLe = toLittleEndian(static_cast<uint64_t>(TypeId::NullableVector));
+                buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+            }
+            arg.serialize(buffer);
+        }, payload_);
+    }
+
+    Buffer::const_iterator deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+        if (std::distance(begin, end) < sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        TypeId typeId = static_cast<TypeId>(fromLittleEndian<uint64_t>(&(*begin)));
+        begin += sizeof(uint64_t);
+        switch (typeId) {
+            case TypeId::Uint: {
+                IntegerType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::Float: {
+                FloatType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::String: {
+                StringType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::Vector: {
+                VectorType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::Bool: {
+                BoolType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::Bitset: {
+                BitsetType value;
+                begin = value.deserialize(begin, end);
+                payload_ = std::move(value);
+                break;
+            }
+            case TypeId::Tensor: {
+                TensorType value;
+                begin = value.deserialize(begin, end);
+                payload_ = std::move(value);
+                break;
+            }
+            case TypeId::SparseVector: {
+                SparseVectorType value;
+                begin = value.deserialize(begin, end);
+                payload_ = std::move(value);
+                break;
+            }
+            case TypeId::Timestamp: {
+                TimestampType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::TimestampVector: {
+                TimestampVectorType value;
+                begin = value.deserialize(begin, end);
+                payload_ = std::move(value);
+                break;
+            }
+            case TypeId::Null: {
+                NullType value;
+                begin = value.deserialize(begin, end);
+                payload_ = value;
+                break;
+            }
+            case TypeId::NullableVector: {
+                NullableVectorType value;
+                begin = value.deserialize(begin, end);
+                payload_ = std::move(value);
+                break;
+            }
+            default:
+                throw std::runtime_error("Unknown type ID");
+        }
+        return begin;
+    }
+
+    TypeId getPayloadTypeId() const {
+        return std::visit([](auto&& arg) -> TypeId {
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, IntegerType>) {
+                return TypeId::Uint;
+            } else if constexpr (std::is_same_v<T, FloatType>) {
+                return TypeId::Float;
+            } else if constexpr (std::is_same_v<T, StringType>) {
+                return TypeId::String;
+            } else if constexpr (std::is_same_v<T, VectorType>) {
+                return TypeId::Vector;
+            } else if constexpr (std::is_same_v<T, BoolType>) {
+                return TypeId::Bool;
+            } else if constexpr (std::is_same_v<T, BitsetType>) {
+                return TypeId::Bitset;
+            } else if constexpr (std::is_same_v<T, TensorType>) {
+                return TypeId::Tensor;
+            } else if constexpr (std::is_same_v<T, SparseVectorType>) {
+                return TypeId::SparseVector;
+            } else if constexpr (std::is_same_v<T, TimestampType>) {
+                return TypeId::Timestamp;
+            } else if constexpr (std::is_same_v<T, TimestampVectorType>) {
+                return TypeId::TimestampVector;
+            } else if constexpr (std::is_same_v<T, NullType>) {
+                return TypeId::Null;
+            } else if constexpr (std::is_same_v<T, NullableVectorType>) {
+                return TypeId::NullableVector;
+            }
+            throw std::runtime_error("Unknown type");
+        }, payload_);
+    }
+
+    size_t memoryFootprint() const {
+        return std::visit([](auto&& arg) -> size_t {
+            return sizeof(Any) - sizeof(arg) + arg.memoryFootprint();
+        }, payload_);
+    }
+
+    template<typename T>
+    auto& getValue() const {
+        return std::get<T>(payload_);
+    }
+
+    // Разные типы не равны; одинаковые сравниваются почленно
+    bool operator==(const Any& other) const {
+        return payload_ == other.payload_;
+    }
+
+private:
+    std::variant<IntegerType, FloatType, StringType, VectorType, BoolType, BitsetType,
+                 TensorType, SparseVectorType, TimestampType, TimestampVectorType, NullType,
+                 NullableVectorType> payload_;
+};
+
+// Счётчики выделений памяти текущего потока. Считают только при сборке с
+// -DSERIALIZATOR_ALLOCATION_TRACKING, которая подменяет глобальный operator new.
+class AllocationTracker {
+public:
+    struct Stats {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    static constexpr bool enabled() {
+#ifdef SERIALIZATOR_ALLOCATION_TRACKING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static Stats& current() {
+        thread_local Stats stats;
+        return stats;
+    }
+
+    static void onAllocate(size_t bytes) {
+        Stats& stats = current();
+        ++stats.allocations;
+        stats.bytes += bytes;
+    }
+
+    // Выделения, сделанные потоком за время жизни объекта
+    class Scope {
+    public:
+        Scope() : start_(current()) {}
+
+        Stats delta() const {
+            const Stats& now = current();
+            return {now.allocations - start_.allocations, now.bytes - start_.bytes};
+        }
+
+    private:
+        Stats start_;
+    };
+
+    template<typename F>
+    static Stats measure(F&& f) {
+        Scope scope;
+        std::forward<F>(f)();
+        return scope.delta();
+    }
+};
+
+#ifdef SERIALIZATOR_ALLOCATION_TRACKING
+void* operator new(size_t size) {
+    AllocationTracker::onAllocate(size);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    AllocationTracker::onAllocate(size);
+    size_t align = static_cast<size_t>(alignment);
+    // aligned_alloc требует размер, кратный выравниванию
+    if (void* ptr = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+#endif
+
+// Гистограмма задержек с логарифмически-линейными корзинами (в стиле HDR).
+// Относительная погрешность значения не превышает 1 / 2^kSubBucketBits.
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBucketBits = 5;
+    static constexpr unsigned kMaxValueBits = 40;
+    static constexpr size_t kSubBucketCount = size_t{1} << kSubBucketBits;
+    static constexpr size_t kBucketCount = (kMaxValueBits - kSubBucketBits + 1) * kSubBucketCount;
+
+    static size_t bucketIndex(uint64_t value) {
+        if (value >= (uint64_t{1} << kMaxValueBits)) {
+            return kBucketCount - 1;
+        }
+        if (value < kSubBucketCount) {
+            return static_cast<size_t>(value);
+        }
+        unsigned exponent = 63 - static_cast<unsigned>(std::countl_zero(value));
+        unsigned shift = exponent - kSubBucketBits;
+        return (shift + 1) * kSubBucketCount + static_cast<size_t>((value >> shift) - kSubBucketCount);
+    }
+
+    // Верхняя граница значений, попадающих в корзину
+    static uint64_t bucketUpperValue(size_t index) {
+        if (index < kSubBucketCount) {
+            return index;
+        }
+        unsigned shift = static_cast<unsigned>(index / kSubBucketCount) - 1;
+        uint64_t base = (kSubBucketCount + index % kSubBucketCount) << shift;
+        return base + (uint64_t{1} << shift) - 1;
+    }
+
+    void record(uint64_t value, uint64_t count = 1) {
+        counts_[bucketIndex(value)] += count;
+        total_ += count;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    uint64_t getCount() const { return total_; }
+    uint64_t getMin() const { return total_ ? min_ : 0; }
+    uint64_t getMax() const { return max_; }
+
+    uint64_t valueAtPercentile(double percentile) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        percentile = std::clamp(percentile, 0.0, 100.0);
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(total_) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, total_);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(bucketUpperValue(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    friend class AtomicLatencyHistogram;
+
+    std::array<uint64_t, kBucketCount> counts_{};
+    uint64_t total_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+// Гистограмма с единственным писателем: запись без блокировок, чтение снимком из любого потока
+class AtomicLatencyHistogram {
+public:
+    void record(uint64_t value) {
+        auto& counter = counts_[LatencyHistogram::bucketIndex(value)];
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value < min_.load(std::memory_order_relaxed)) {
+            min_.store(value, std::memory_order_relaxed);
+        }
+        if (value > max_.load(std::memory_order_relaxed)) {
+            max_.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    LatencyHistogram snapshot() const {
+        LatencyHistogram result;
+        for (size_t i = 0; i < LatencyHistogram::kBucketCount; ++i) {
+            result.counts_[i] = counts_[i].load(std::memory_order_relaxed);
+            result.total_ += result.counts_[i];
+        }
+        result.min_ = min_.load(std::memory_order_relaxed);
+        result.max_ = max_.load(std::memory_order_relaxed);
+        return result;
+    }
+
+    // Только когда писатель больше не пишет, например при завершении его потока
+    void reset() {
+        for (auto& counter : counts_) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, LatencyHistogram::kBucketCount> counts_{};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+    std::atomic<uint64_t> max_{0};
+};
+
+// Сбор задержек кодирования/декодирования по классам размера сообщения.
+// Каждый поток пишет в собственный набор гистограмм, снимки сливаются при чтении.
+class CodecLatencyRecorder {
+public:
+    enum class Operation { Encode, Decode };
+
+    static constexpr size_t kOperationCount = 2;
+    static constexpr size_t kSizeClassCount = 5;
+
+    // Классы размера: <256 Б, <4 КБ, <64 КБ, <1 МБ, остальное
+    static size_t sizeClass(size_t bytes) {
+        size_t cls = 0;
+        for (size_t limit = 256; cls + 1 < kSizeClassCount && bytes >= limit; limit <<= 4) {
+            ++cls;
+        }
+        return cls;
+    }
+
+    static const char* sizeClassName(size_t cls) {
+        static const char* names[kSizeClassCount] = {"<256B", "<4KiB", "<64KiB", "<1MiB", ">=1MiB"};
+        return names[cls];
+    }
+
+    static void record(Operation op, size_t bytes, uint64_t nanos) {
+        threadSlot().histograms[slotIndex(op, sizeClass(bytes))].record(nanos);
+    }
+
+    static LatencyHistogram snapshot(Operation op, size_t cls) {
+        Registry& registry = CodecLatencyRecorder::registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        LatencyHistogram result = registry.retired[slotIndex(op, cls)];
+        // Свободные слоты обнулены и ничего не добавляют
+        for (const auto& slot : registry.slots) {
+            result.merge(slot->histograms[slotIndex(op, cls)].snapshot());
+        }
+        return result;
+    }
+
+    static void exportPercentiles(std::ostream& out) {
+        out << "op\tsize\tcount\tmin\tp50\tp90\tp99\tp99.9\tmax (ns)\n";
+        for (size_t o = 0; o < kOperationCount; ++o) {
+            auto op = static_cast<Operation>(o);
+            for (size_t cls = 0; cls < kSizeClassCount; ++cls) {
+                LatencyHistogram h = snapshot(op, cls);
+                if (h.getCount() == 0) {
+                    continue;
+                }
+                out << (op == Operation::Encode ? "encode" : "decode") << '\t' << sizeClassName(cls) << '\t'
+                    << h.getCount() << '\t' << h.getMin() << '\t' << h.valueAtPercentile(50.0) << '\t'
+                    << h.valueAtPercentile(90.0) << '\t' << h.valueAtPercentile(99.0) << '\t'
+                    << h.valueAtPercentile(99.9) << '\t' << h.getMax() << '\n';
+            }
+        }
+    }
+
+    // RAII-замер одной операции; размер может стать известен только в конце
+    class Scope {
+    public:
+        explicit Scope(Operation op, size_t bytes = 0)
+            : op_(op), bytes_(bytes), start_(std::chrono::steady_clock::now()) {}
+
+        void setBytes(size_t bytes) { bytes_ = bytes; }
+
+        ~Scope() {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            record(op_, bytes_, static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+
+    private:
+        Operation op_;
+        size_t bytes_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+private:
+    static constexpr size_t kSlotHistogramCount = kOperationCount * kSizeClassCount;
+
+    struct ThreadSlot {
+        std::array<AtomicLatencyHistogram, kSlotHistogramCount> histograms;
+    };
+
+    // Слотов не больше, чем потоков, живших одновременно: слот завершившегося потока сливается
+    // в retired и переходит следующему потоку
+    struct Registry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ThreadSlot>> slots;
+        std::vector<ThreadSlot*> freeSlots;
+        std::array<LatencyHistogram, kSlotHistogramCount> retired;
+    };
+
+    // Владение слотом на время жизни потока
+    class SlotLease {
+    public:
+        SlotLease() {
+            Registry& registry = CodecLatencyRecorder::registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            if (registry.freeSlots.empty()) {
+                registry.slots.push_back(std::make_unique<ThreadSlot>());
+                slot_ = registry.slots.back().get();
+            } else {
+                slot_ = registry.freeSlots.back();
+                registry.freeSlots.pop_back();
+            }
+        }
+
+        ~SlotLease() {
+            Registry& registry = CodecLatencyRecorder::registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (size_t i = 0; i < kSlotHistogramCount; ++i) {
+                registry.retired[i].merge(slot_->histograms[i].snapshot());
+                slot_->histograms[i].reset();
+            }
+            registry.freeSlots.push_back(slot_);
+        }
+
+        SlotLease(const SlotLease&) = delete;
+        SlotLease& operator=(const SlotLease&) = delete;
+
+        ThreadSlot& slot() const { return *slot_; }
+
+    private:
+        ThreadSlot* slot_ = nullptr;
+    };
+
+    static size_t slotIndex(Operation op, size_t cls) {
+        return static_cast<size_t>(op) * kSizeClassCount + cls;
+    }
+
+    static Registry& registry() {
+        static Registry registry;
+        return registry;
+    }
+
+    static ThreadSlot& threadSlot() {
+        thread_local SlotLease lease;
+        return lease.slot();
+    }
+};
+
+inline void VectorType::serialize(Buffer& buffer) const {
+    auto sizeLe = toLittleEndian(static_cast<uint64_t>(elements_.size()));
+    buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
+    for (const auto& element : elements_) {
+        element.serialize(buffer);
+    }
+}
+
+inline Buffer::const_iterator VectorType::deserialize(Buffer::const_iterator begin, Buffer::const_iterator end) {
+    if (std::distance(begin, end) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+        throw std::runtime_error("Not enough data for deserialization");
+    }
+    uint64_t size = fromLittleEndian<uint64_t>(&(*begin));
+    begin += sizeof(uint64_t);
+    elements_.clear();
+    return decodeElements(elements_, size, begin, end);
+}
+
+inline size_t VectorType::memoryFootprint() const {
+    return sizeof(*this) - sizeof(elements_) + ::memoryFootprint(elements_);
+}
+
+inline size_t memoryFootprint(const std::vector<Any>& elements) {
+    size_t total = sizeof(elements) + elements.capacity() * sizeof(Any);
+    for (const auto& element : elements) {
+        total += element.memoryFootprint() - sizeof(Any);
+    }
+    return total;
+}
+
+// count элементов подряд; память резервирует вызывающий
+inline Buffer::const_iterator decodeRun(std::vector<Any>& out, uint64_t count, Buffer::const_iterator begin,
+                                        Buffer::const_iterator end) {
+    for (uint64_t i = 0; i < count; ++i) {
+        Any any(IntegerType{});
+        begin = any.deserialize(begin, end);
+        out.push_back(std::move(any));
+    }
+    return begin;
+}
+
+// Запас под известное число элементов резервируется один раз; блоки chunked-вектора дописываются
+// без резервирования, чтобы out рос геометрически, а не перевыделялся под каждый блок
+inline Buffer::const_iterator decodeElements(std::vector<Any>& out, uint64_t count, Buffer::const_iterator begin,
+                                             Buffer::const_iterator end) {
+    if (count == kChunkedCount) {
+        while (true) {
+            if (std::distance(begin, end) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+                throw std::runtime_error("Not enough data for deserialization");
+            }
+            uint64_t chunk = fromLittleEndian<uint64_t>(&(*begin));
+            begin += sizeof(uint64_t);
+            if (chunk == 0) {
+                return begin;
+            }
+            if (chunk == kChunkedCount) {
+                throw std::runtime_error("Malformed chunked vector");
+            }
+            begin = decodeRun(out, chunk, begin, end);
+        }
+    }
+    // Каждый элемент занимает не меньше 8 байт, поэтому запас ограничен остатком буфера
+    out.reserve(out.size() + std::min<uint64_t>(count, static_cast<uint64_t>(std::distance(begin, end)) / sizeof(uint64_t)));
+    return decodeRun(out, count, begin, end);
+}
+
+// Полезная нагрузка однородного вектора Uint (T = uint64_t) или Float (T = double) прямо в типизированный
+// массив: проверка тегов сериями, затем выборка значений с шагом 16 байт, без объектов Any
+template<typename T>
+Buffer::const_iterator gatherScalars(Buffer::const_iterator begin, Buffer::const_iterator end, std::vector<T>& out) {
+    static_assert(std::is_same_v<T, uint64_t> || std::is_same_v<T, double>, "Uint or Float values only");
+    constexpr TypeId expected = std::is_same_v<T, uint64_t> ? TypeId::Uint : TypeId::Float;
+    if (std::distance(begin, end) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+        throw std::runtime_error("Not enough data for deserialization");
+    }
+    uint64_t count = fromLittleEndian<uint64_t>(&(*begin));
+    begin += sizeof(uint64_t);
+    if (count > static_cast<uint64_t>(std::distance(begin, end)) / 16) {
+        throw std::runtime_error("Not enough data for deserialization");
+    }
+    out.resize(static_cast<size_t>(count));
+    if (count == 0) {
+        return begin;
+    }
+    const std::byte* data = &(*begin);
+    if (fromLittleEndian<uint64_t>(data) != static_cast<uint64_t>(expected) ||
+        scalarRunLength(data, static_cast<size_t>(count)) != count) {
+        throw std::runtime_error("Vector is not homogeneous");
+    }
+    for (size_t k = 0; k < out.size(); ++k) {
+        out[k] = std::bit_cast<T>(fromLittleEndian<uint64_t>(data + k * 16 + sizeof(uint64_t)));
+    }
+    return begin + static_cast<std::ptrdiff_t>(count * 16);
+}
+
+// Количество узлов Any в дереве, включая вложенные
+inline uint64_t countElements(const std::vector<Any>& elements) {
+    uint64_t count = elements.size();
+    for (const auto& element : elements) {
+        if (element.getPayloadTypeId() == TypeId::Vector) {
+            count += countElements(element.getValue<VectorType>().getElements());
+        }
+    }
+    return count;
+}
+
+// Перевод вложенных VectorType одинаковой длины с листьями FloatType или IntegerType в тензор
+inline TensorType tensorFromNestedVectors(const VectorType& root) {
+    std::vector<uint64_t> shape;
+    const Any* probe = nullptr;
+    for (const VectorType* level = &root;;) {
+        shape.push_back(level->getElements().size());
+        if (level->getElements().empty()) {
+            break;
+        }
+        probe = &level->getElements().front();
+        if (probe->getPayloadTypeId() != TypeId::Vector) {
+            break;
+        }
+        level = &probe->getValue<VectorType>();
+    }
+    TypeId leafType = probe ? probe->getPayloadTypeId() : TypeId::Float;
+    if (leafType != TypeId::Float && leafType != TypeId::Uint) {
+        throw std::runtime_error("Tensor leaves must be FloatType or IntegerType");
+    }
+    TensorType tensor(leafType == TypeId::Float ? DType::Float64 : DType::Uint64, shape);
+    double* outFloat = leafType == TypeId::Float ? tensor.mutableData<double>() : nullptr;
+    uint64_t* outUint = leafType == TypeId::Uint ? tensor.mutableData<uint64_t>() : nullptr;
+    size_t next = 0;
+    std::function<void(const VectorType&, size_t)> walk = [&](const VectorType& level, size_t depth) {
+        if (level.getElements().size() != shape[depth]) {
+            throw std::runtime_error("Ragged vectors cannot form a tensor");
+        }
+        for (const auto& element : level.getElements()) {
+            if (depth + 1 < shape.size()) {
+                walk(element.getValue<VectorType>(), depth + 1);
+            } else if (outUint) {
+                outUint[next++] = element.getValue<IntegerType>().getValue();
+            } else {
+                outFloat[next++] = element.getValue<FloatType>().getValue();
+            }
+        }
+    };
+    walk(root, 0);
+    return tensor;
+}
+
+// Перевод плотного VectorType из IntegerType или FloatType в разреженный; нули, кроме -0.0, отбрасываются
+inline SparseVectorType sparseFromDense(const VectorType& dense) {
+    const auto& elements = dense.getElements();
+    TypeId valueType = elements.empty() ? TypeId::Float : elements.front().getPayloadTypeId();
+    SparseVectorType result(valueType, elements.size());
+    for (uint64_t i = 0; i < elements.size(); ++i) {
+        if (valueType == TypeId::Uint) {
+            result.push_uint(i, elements[i].getValue<IntegerType>().getValue());
+        } else {
+            result.push_float(i, elements[i].getValue<FloatType>().getValue());
+        }
+    }
+    return result;
+}
+
+inline VectorType sparseToDense(const SparseVectorType& sparseVector) {
+    VectorType dense;
+    if (sparseVector.getValueType() == TypeId::Uint) {
+        for (uint64_t value : sparseVector.toDense<uint64_t>()) {
+            dense.push_back(IntegerType(value));
+        }
+    } else {
+        for (double value : sparseVector.toDense<double>()) {
+            dense.push_back(FloatType(value));
+        }
+    }
+    return dense;
+}
+
+// Перевод VectorType из NullType и значений одного типа (Uint или Float) в столбец с битовой картой
+inline NullableVectorType nullableFromVector(const VectorType& vector) {
+    const auto& elements = vector.getElements();
+    auto firstValue = std::find_if(elements.begin(), elements.end(),
+                                   [](const Any& e) { return e.getPayloadTypeId() != TypeId::Null; });
+    NullableVectorType result(firstValue == elements.end() ? TypeId::Float : firstValue->getPayloadTypeId());
+    for (const auto& element : elements) {
+        switch (element.getPayloadTypeId()) {
+            case TypeId::Null:
+                result.push_null();
+                break;
+            case TypeId::Uint:
+                result.push_uint(element.getValue<IntegerType>().getValue());
+                break;
+            case TypeId::Float:
+                result.push_float(element.getValue<FloatType>().getValue());
+                break;
+            default:
+                throw std::runtime_error("Nullable vector values must be Uint or Float");
+        }
+    }
+    return result;
+}
+
+inline VectorType nullableToVector(const NullableVectorType& column) {
+    VectorType vector;
+    size_t rank = 0;
+    for (uint64_t i = 0; i < column.size(); ++i) {
+        if (column.isNull(i)) {
+            vector.push_back(NullType());
+            continue;
+        }
+        uint64_t raw = column.getValues()[rank++];
+        if (column.getValueType() == TypeId::Uint) {
+            vector.push_back(IntegerType(raw));
+        } else {
+            double value;
+            std::memcpy(&value, &raw, sizeof(value));
+            vector.push_back(FloatType(value));
+        }
+    }
+    return vector;
+}
+
+// Необязательный заголовок буфера Serializator (48 байт): магия, версия, флаги (пока все зарезервированы),
+// число корневых и всех элементов, длина тела. Буфер без заголовка начинается сразу с числа элементов;
+// магия как число элементов была бы заведомо невозможной, поэтому форматы различимы по первым байтам.
+struct WireHeader {
+    static constexpr std::array<char, 8> kMagic = {'S', 'R', 'Z', 'W', 'I', 'R', 'E', '\1'};
+    static constexpr uint64_t kVersion = 1;
+    static constexpr size_t kSize = 48;
+
+    // Ненулевые флаги означают кодирование, которого этот читатель не знает
+    static constexpr uint64_t kSupportedFlags = 0;
+
+    uint64_t version = kVersion;
+    uint64_t flags = 0;
+    uint64_t rootCount = 0;
+    uint64_t totalCount = 0;   // все узлы Any, включая вложенные
+    uint64_t bodyLength = 0;   // байт после заголовка
+
+    static bool present(const std::byte* data, size_t size) {
+        return size >= kMagic.size() && std::equal(kMagic.begin(), kMagic.end(), reinterpret_cast<const char*>(data));
+    }
+
+    static WireHeader parse(const std::byte* data, size_t size) {
+        WireHeader header = parseFields(data, size);
+        if (header.bodyLength > size - kSize) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        return header;
+    }
+
+    // Поля без сверки длины тела с размером буфера: при потоковом чтении тело приходит позже
+    static WireHeader parseFields(const std::byte* data, size_t size) {
+        if (!present(data, size) || size < kSize) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        WireHeader header;
+        header.version = fromLittleEndian<uint64_t>(data + 8);
+        header.flags = fromLittleEndian<uint64_t>(data + 16);
+        header.rootCount = fromLittleEndian<uint64_t>(data + 24);
+        header.totalCount = fromLittleEndian<uint64_t>(data + 32);
+        header.bodyLength = fromLittleEndian<uint64_t>(data + 40);
+        if (header.version != kVersion) {
+            throw std::runtime_error("Unsupported format version");
+        }
+        if (header.flags & ~kSupportedFlags) {
+            throw std::runtime_error("Unsupported format feature flags");
+        }
+        // В теле есть хотя бы число корневых элементов
+        if (header.bodyLength < sizeof(uint64_t)) {
+            throw std::runtime_error("Wire header body is too short");
+        }
+        return header;
+    }
+
+    // Счётчики берутся из недоверенного ввода: для резервирования они ограничиваются телом
+    // (каждый элемент занимает не меньше 8 байт), а после разбора сверяются с результатом
+    uint64_t rootCapacity() const { return std::min(rootCount, bodyLength / sizeof(uint64_t)); }
+    uint64_t nodeCapacity() const { return std::min(totalCount, bodyLength / sizeof(uint64_t)); }
+
+    void checkRootCount(uint64_t roots) const {
+        if (roots != rootCount) {
+            throw std::runtime_error("Wire header counts do not match the body");
+        }
+    }
+
+    // Число всех узлов сверяется там, где оно известно без второго обхода дерева
+    void checkCounts(uint64_t roots, uint64_t nodes) const {
+        if (roots != rootCount || nodes != totalCount) {
+            throw std::runtime_error("Wire header counts do not match the body");
+        }
+    }
+
+    void writeTo(std::byte* data) const {
+        std::copy(kMagic.begin(), kMagic.end(), reinterpret_cast<char*>(data));
+        const uint64_t fields[] = {version, flags, rootCount, totalCount, bodyLength};
+        for (size_t i = 0; i < std::size(fields); ++i) {
+            auto le = toLittleEndian(fields[i]);
+            std::copy(le.begin(), le.end(), data + 8 * (i + 1));
+        }
+    }
+};
+
+// Класс Serializator
+class Serializator {
+public:
+    template<typename Arg>
+    void push(Arg&& val) {
+        storage_.emplace_back(std::forward<Arg>(val));
+    }
+
+    Buffer serialize() const {
+        return serialize(false);
+    }
+
+    // С заголовком WireHeader читатель сразу знает вариант кодирования и размеры
+    Buffer serialize(bool withHeader) const {
+#ifdef SERIALIZATOR_LATENCY_HISTOGRAM
+        CodecLatencyRecorder::Scope latency(CodecLatencyRecorder::Operation::Encode);
+#endif
+        Buffer buffer;
+        if (withHeader) {
+            buffer.resize(WireHeader::kSize);
+        }
+        auto sizeLe = toLittleEndian(static_cast<uint64_t>(storage_.size()));
+        buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
+        for (const auto& element : storage_) {
+            element.serialize(buffer);
+        }
+        if (withHeader) {
+            WireHeader header;
+            header.rootCount = storage_.size();
+            header.totalCount = countElements(storage_);
+            header.bodyLength = buffer.size() - WireHeader::kSize;
+            header.writeTo(buffer.data());
+        }
+#ifdef SERIALIZATOR_LATENCY_HISTOGRAM
+        latency.setBytes(buffer.size());
+#endif
+        return buffer;
+    }
+
+    static std::vector<Any> deserialize(const Buffer& buffer) {
+        return deserialize(buffer, false);
+    }
+
+    // Число всех узлов из заголовка сверяется только по запросу: это второй обход дерева.
+    // Число корней и длина тела проверяются всегда.
+    static std::vector<Any> deserialize(const Buffer& buffer, bool checkNodeCount) {
+#ifdef SERIALIZATOR_LATENCY_HISTOGRAM
+        CodecLatencyRecorder::Scope latency(CodecLatencyRecorder::Operation::Decode, buffer.size());
+#endif
+        std::vector<Any> result;
+        auto begin = buffer.cbegin();
+        auto end = buffer.cend();
+        std::optional<WireHeader> header;
+        if (WireHeader::present(buffer.data(), buffer.size())) {
+            header = WireHeader::parse(buffer.data(), buffer.size());
+            begin += WireHeader::kSize;
+            end = begin + header->bodyLength;
+            result.reserve(header->rootCapacity());
+        }
+        if (std::distance(begin, end) < sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t size = fromLittleEndian<uint64_t>(&(*begin));
+        begin += sizeof(uint64_t);
+        begin = decodeElements(result, size, begin, end);
+        if (header) {
+            if (begin != end) {
+                throw std::runtime_error("Trailing data in wire body");
+            }
+            if (checkNodeCount) {
+                header->checkCounts(result.size(), countElements(result));
+            } else {
+                header->checkRootCount(result.size());
+            }
+        }
+        return result;
+    }
+
+    const std::vector<Any>& getStorage() const {
+        return storage_;
+    }
+
+private:
+    std::vector<Any> storage_;
+};
+
+// Потоковая запись последовательности, длина которой заранее неизвестна; память не растёт с объёмом.
+// BackPatch: на месте числа элементов пишется заглушка, исправляемая через seekp при закрытии вектора,
+// результат побайтно совпадает с Serializator::serialize (без заголовка). Chunked — для потоков без
+// позиционирования (сокеты, каналы): вместо числа пишется kChunkedCount, а элементы копятся в блок
+// не больше kChunkBytes, который уходит в поток со своим числом элементов.
+//   StreamEncoder encoder(std::cout, StreamEncoder::Mode::Chunked);
+//   encoder.beginVector();
+//   while (auto row = nextRow()) { encoder.push(IntegerType(*row)); }
+//   encoder.endVector();
+//   encoder.finish();
+class StreamEncoder {
+public:
+    enum class Mode { BackPatch, Chunked };
+
+    static constexpr size_t kChunkBytes = 64 * 1024;
+
+    StreamEncoder(std::ostream& out, Mode mode) : out_(out), mode_(mode) {
+        if (mode_ == Mode::BackPatch && out_.tellp() == std::ostream::pos_type(-1)) {
+            throw std::runtime_error("Back-patching requires a seekable stream");
+        }
+        openLevel();
+    }
+
+    template<typename Arg>
+    void push(Arg&& val) {
+        if constexpr (std::is_same_v<std::decay_t<Arg>, Any>) {
+            writeElement(val);
+        } else {
+            writeElement(Any(std::forward<Arg>(val)));
+        }
+    }
+
+    // Элементы до endVector попадают во вложенный вектор
+    void beginVector() {
+        checkOpen();
+        auto tag = toLittleEndian(static_cast<uint64_t>(TypeId::Vector));
+        ++levels_.back().count;
+        if (mode_ == Mode::BackPatch) {
+            write(tag.data(), tag.size());
+        } else {
+            // Вектор замыкает текущий блок родителя, его содержимое идёт следом
+            pending_.insert(pending_.end(), tag.begin(), tag.end());
+            ++pendingCount_;
+            flushChunk();
+        }
+        openLevel();
+    }
+
+    void endVector() {
+        checkOpen();
+        if (levels_.size() == 1) {
+            throw std::runtime_error("endVector without beginVector");
+        }
+        closeLevel();
+    }
+
+    // Закрывает корневую последовательность; незакрытые векторы — ошибка
+    void finish() {
+        checkOpen();
+        if (levels_.size() != 1) {
+            throw std::runtime_error("Unclosed vector in stream");
+        }
+        closeLevel();
+        out_.flush();
+        if (!out_) {
+            throw std::runtime_error("Failed to write stream");
+        }
+    }
+
+    uint64_t rootCount() const { return rootCount_; }
+
+private:
+    struct Level {
+        std::ostream::pos_type countAt;
+        uint64_t count = 0;
+    };
+
+    void checkOpen() const {
+        if (levels_.empty()) {
+            throw std::runtime_error("Stream is already finished");
+        }
+    }
+
+    void writeElement(const Any& value) {
+        checkOpen();
+        ++levels_.back().count;
+        if (mode_ == Mode::BackPatch) {
+            scratch_.clear();
+            value.serialize(scratch_);
+            write(scratch_.data(), scratch_.size());
+            return;
+        }
+        value.serialize(pending_);
+        ++pendingCount_;
+        if (pending_.size() >= kChunkBytes) {
+            flushChunk();
+        }
+    }
+
+    void openLevel() {
+        Level level;
+        if (mode_ == Mode::BackPatch) {
+            level.countAt = out_.tellp();
+            writeCount(0);
+        } else {
+            writeCount(kChunkedCount);
+        }
+        levels_.push_back(level);
+    }
+
+    void closeLevel() {
+        Level level = levels_.back();
+        levels_.pop_back();
+        if (levels_.empty()) {
+            rootCount_ = level.count;
+        }
+        if (mode_ == Mode::Chunked) {
+            flushChunk();
+            writeCount(0);
+            return;
+        }
+        auto here = out_.tellp();
+        out_.seekp(level.countAt);
+        writeCount(level.count);
+        out_.seekp(here);
+        if (!out_) {
+            throw std::runtime_error("Failed to seek stream");
+        }
+    }
+
+    void flushChunk() {
+        if (pendingCount_ == 0) {
+            return;
+        }
+        writeCount(pendingCount_);
+        write(pending_.data(), pending_.size());
+        pending_.clear();
+        pendingCount_ = 0;
+    }
+
+    void writeCount(uint64_t count) {
+        auto le = toLittleEndian(count);
+        write(le.data(), le.size());
+    }
+
+    void write(const std::byte* data, size_t size) {
+        out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+        if (!out_) {
+            throw std::runtime_error("Failed to write stream");
+        }
+    }
+
+    std::ostream& out_;
+    Mode mode_;
+    std::vector<Level> levels_;
+    Buffer scratch_;
+    Buffer pending_;  // текущий блок самого вложенного вектора
+    uint64_t pendingCount_ = 0;
+    uint64_t rootCount_ = 0;
+};
+
+// Кодировщик без кучи: пишет формат Serializator прямо в буфер вызывающего. При нехватке места
+// запись прекращается, но размер продолжает считаться, так что size() сообщает, сколько нужно.
+// Длины векторов дописываются при endVector, глубина вложенности ограничена kMaxDepth.
+// Все методы constexpr, поэтому тот же код собирает константные сообщения при компиляции.
+class SpanWriter {
+public:
+    static constexpr size_t kMaxDepth = 32;
+
+    constexpr explicit SpanWriter(std::span<std::byte> out) : out_(out) {
+        putWord(0);  // число корневых элементов, записывается в finish
+    }
+
+    constexpr bool pushUint(uint64_t value) { return putScalar(TypeId::Uint, value); }
+
+    constexpr bool pushFloat(double value) { return putScalar(TypeId::Float, std::bit_cast<uint64_t>(value)); }
+
+    constexpr bool pushTimestamp(int64_t nanoseconds) {
+        return putScalar(TypeId::Timestamp, static_cast<uint64_t>(nanoseconds));
+    }
+
+    constexpr bool pushString(std::string_view value) {
+        element(TypeId::String);
+        putWord(value.size());
+        if (fits(value.size())) {
+            for (size_t i = 0; i < value.size(); ++i) {
+                out_[size_ + i] = static_cast<std::byte>(value[i]);
+            }
+        }
+        size_ += value.size();
+        return !overflowed();
+    }
+
+    constexpr bool pushBool(bool value) {
+        element(TypeId::Bool);
+        if (fits(1)) {
+            out_[size_] = static_cast<std::byte>(value ? 1 : 0);
+        }
+        ++size_;
+        return !overflowed();
+    }
+
+    constexpr bool pushNull() {
+        element(TypeId::Null);
+        return !overflowed();
+    }
+
+    // Последующие элементы до endVector попадают в вектор
+    constexpr bool beginVector() {
+        element(TypeId::Vector);
+        if (depth_ + 1 == kMaxDepth) {
+            unbalanced_ = true;
+            return false;
+        }
+        ++depth_;
+        countAt_[depth_] = size_;
+        counts_[depth_] = 0;
+        putWord(0);
+        return !overflowed();
+    }
+
+    constexpr bool endVector() {
+        if (depth_ == 0) {
+            unbalanced_ = true;
+            return false;
+        }
+        patch(countAt_[depth_], counts_[depth_]);
+        --depth_;
+        return !overflowed();
+    }
+
+    // Дописывает число корневых элементов; true, если сообщение целиком поместилось и векторы закрыты
+    constexpr bool finish() {
+        unbalanced_ |= depth_ != 0;
+        patch(0, counts_[0]);
+        return ok();
+    }
+
+    constexpr bool overflowed() const { return size_ > out_.size(); }
+    constexpr bool ok() const { return !overflowed() && !unbalanced_; }
+
+    // Сколько байт занимает (или занял бы) закодированный буфер
+    constexpr size_t size() const { return size_; }
+    constexpr size_t capacity() const { return out_.size(); }
+
+    constexpr std::span<const std::byte> bytes() const { return out_.first(std::min(size_, out_.size())); }
+
+private:
+    constexpr bool fits(size_t bytes) const { return size_ + bytes <= out_.size(); }
+
+    constexpr void putWord(uint64_t value) {
+        if (fits(sizeof(uint64_t))) {
+            patch(size_, value);
+        }
+        size_ += sizeof(uint64_t);
+    }
+
+    constexpr void patch(size_t at, uint64_t value) {
+        if (at + sizeof(uint64_t) > out_.size()) {
+            return;
+        }
+        storeLittleEndian(out_.data() + at, value);
+    }
+
+    constexpr void element(TypeId type) {
+        ++counts_[depth_];
+        putWord(static_cast<uint64_t>(type));
+    }
+
+    constexpr bool putScalar(TypeId type, uint64_t value) {
+        element(type);
+        putWord(value);
+        return !overflowed();
+    }
+
+    std::span<std::byte> out_;
+    size_t size_ = 0;
+    size_t depth_ = 0;
+    bool unbalanced_ = false;
+    std::array<uint64_t, kMaxDepth> counts_{};
+    std::array<size_t, kMaxDepth> countAt_{};
+};
+
+// Буфер отдельной базой, чтобы он был создан раньше SpanWriter, который в него пишет
+template<size_t N>
+struct StaticBuffer {
+    std::array<std::byte, N> storage_{};
+};
+
+// SpanWriter с собственным буфером ёмкости N; объект можно держать на стеке
+template<size_t N>
+class StaticSerializator : private StaticBuffer<N>, public SpanWriter {
+public:
+    StaticSerializator() : SpanWriter(StaticBuffer<N>::storage_) {}
+
+    StaticSerializator(const StaticSerializator&) = delete;
+    StaticSerializator& operator=(const StaticSerializator&) = delete;
+
+    const std::array<std::byte, N>& storage() const { return StaticBuffer<N>::storage_; }
+};
+
+// Константное сообщение, собранное компилятором: build(SpanWriter&) выполняется дважды — сначала
+// для подсчёта размера на пустом буфере, затем для записи в массив точно нужной длины.
+// build должен быть лямбдой без захвата, ошибка кодирования — ошибка компиляции.
+//   constexpr auto kHello = constantMessage([](SpanWriter& w) { w.pushUint(1); w.pushString("hello"); });
+template<typename Build>
+consteval auto constantMessage(Build build) {
+    constexpr size_t size = [] {
+        SpanWriter counter{std::span<std::byte>()};
+        Build{}(counter);
+        counter.finish();
+        return counter.size();
+    }();
+    std::array<std::byte, size> message{};
+    SpanWriter writer(message);
+    build(writer);
+    if (!writer.finish()) {
+        throw std::runtime_error("Constant message vectors are not balanced");
+    }
+    return message;
+}
+
+static_assert(constantMessage([](SpanWriter& w) { w.pushString("ok"); }).size() == 3 * sizeof(uint64_t) + 2);
+
+// Параллельное декодирование буферов без индекса смещений. Каждый поток начинает с произвольного
+// места своего куска и перебирает байтовые смещения, пока с какого-то из них не разберутся подряд
+// kConfirmElements корневых элементов (проверяются теги, длины и границы) — это гипотеза о границе.
+// Затем поток проходит от неё до начала следующего куска. Сшивка последовательна: истинная граница,
+// дошедшая из предыдущего куска, ищется в списке потока; проходы детерминированы, поэтому после
+// совпадения они совпадают и дальше. Неудачная гипотеза исправляется последовательным проходом.
+namespace parallel {
+
+constexpr size_t kMaxNesting = 256;
+constexpr size_t kConfirmElements = 8;
+constexpr size_t kMinChunkBytes = 1 << 20;
+// Дальше кусок не угадывается, а дочитывается при сшивке: каждая гипотеза может стоить разбора
+// длинного вектора, и без предела поиск квадратичен на враждебных данных
+constexpr size_t kMaxBoundaryCandidates = 4096;
+
+// Конец элемента, начинающегося с pos, или nullptr, если данные не похожи на элемент.
+// Ничего не выделяет и не бросает исключений: вызывается на каждой гипотезе.
+inline const std::byte* elementEnd(const std::byte* pos, const std::byte* end, size_t depth = 0) {
+    if (end - pos < static_cast<std::ptrdiff_t>(sizeof(uint64_t)) || depth > kMaxNesting) {
+        return nullptr;
+    }
+    uint64_t tag = fromLittleEndian<uint64_t>(pos);
+    pos += sizeof(uint64_t);
+    uint64_t left = static_cast<uint64_t>(end - pos);
+    auto field = [&](uint64_t offset) {
+        return left >= offset + sizeof(uint64_t) ? fromLittleEndian<uint64_t>(pos + offset) : UINT64_MAX;
+    };
+    auto payload = [&](uint64_t bytes) -> const std::byte* { return bytes <= left ? pos + bytes : nullptr; };
+    switch (static_cast<TypeId>(tag)) {
+        case TypeId::Uint:
+        case TypeId::Float:
+        case TypeId::Timestamp:
+            return payload(sizeof(uint64_t));
+        case TypeId::Bool:
+            return payload(1);
+        case TypeId::Null:
+            return pos;
+        case TypeId::String: {
+            uint64_t length = field(0);
+            return length <= left ? payload(sizeof(uint64_t) + length) : nullptr;
+        }
+        case TypeId::Vector: {
+            uint64_t count = field(0);
+            const std::byte* next = pos + sizeof(uint64_t);
+            if (count == kChunkedCount) {
+                while (next && end - next >= static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+                    uint64_t chunk = fromLittleEndian<uint64_t>(next);
+                    next += sizeof(uint64_t);
+                    if (chunk == 0) {
+                        return next;
+                    }
+                    if (chunk > static_cast<uint64_t>(end - next) / sizeof(uint64_t)) {
+                        return nullptr;
+                    }
+                    for (uint64_t i = 0; i < chunk && next; ++i) {
+                        next = elementEnd(next, end, depth + 1);
+                    }
+                }
+                return nullptr;
+            }
+            if (count > left / sizeof(uint64_t)) {
+                return nullptr;
+            }
+            for (uint64_t i = 0; i < count && next; ++i) {
+                next = elementEnd(next, end, depth + 1);
+            }
+            return next;
+        }
+        case TypeId::Bitset: {
+            uint64_t bitCount = field(0);
+            return bitCount / 8 <= left ? payload(sizeof(uint64_t) + bits::wordCount(bitCount) * 8) : nullptr;
+        }
+        case TypeId::Tensor: {
+            uint64_t rank = field(8);
+            if (rank > TensorLayout::kMaxRank) {
+                return nullptr;
+            }
+            uint64_t header = (4 + 2 * rank) * sizeof(uint64_t);
+            uint64_t dataBytes = field(header - 16);
+            uint64_t padding = field(header - 8);
+            return dataBytes <= left && padding < TensorLayout::kTensorAlignment ? payload(header + padding + dataBytes)
+                                                                               : nullptr;
+        }
+        case TypeId::SparseVector: {
+            uint64_t nonZeros = field(16);
+            uint64_t indexBytes = field(24);
+            return indexBytes <= left && nonZeros <= left / sizeof(uint64_t)
+                       ? payload(4 * sizeof(uint64_t) + indexBytes + nonZeros * sizeof(uint64_t))
+                       : nullptr;
+        }
+        case TypeId::TimestampVector: {
+            uint64_t streamBytes = field(16);
+            return streamBytes <= left ? payload(3 * sizeof(uint64_t) + streamBytes) : nullptr;
+        }
+        case TypeId::NullableVector: {
+            uint64_t nullCount = field(8);
+            uint64_t bitCount = field(16);
+            if (bitCount / 8 > left || nullCount > bitCount) {
+                return nullptr;
+            }
+            return payload(3 * sizeof(uint64_t) + bits::wordCount(bitCount) * 8 + (bitCount - nullCount) * sizeof(uint64_t));
+        }
+    }
+    return nullptr;
+}
+
+// Число элементов блочного вектора; pos указывает на заголовок первого блока. Для форматов, которым
+// длина массива нужна до его элементов: блоки проходятся без декодирования
+inline uint64_t chunkedLength(const std::byte* pos, const std::byte* end) {
+    uint64_t total = 0;
+    while (true) {
+        if (end - pos < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t chunk = fromLittleEndian<uint64_t>(pos);
+        pos += sizeof(uint64_t);
+        if (chunk == 0) {
+            return total;
+        }
+        if (chunk == kChunkedCount) {
+            throw std::runtime_error("Malformed chunked vector");
+        }
+        for (uint64_t i = 0; i < chunk; ++i) {
+            pos = elementEnd(pos, end);
+            if (!pos) {
+                throw std::runtime_error("Malformed element in serialized data");
+            }
+        }
+        total += chunk;
+    }
+}
+
+// Начала элементов от pos, пока не будет записано первое начало не раньше limit; true, если
+// проход дошёл до конца данных (последний элемент закончился ровно на end или дальше разбора нет)
+inline bool walk(const std::byte* pos, const std::byte* limit, const std::byte* end, std::vector<const std::byte*>& out) {
+    while (true) {
+        out.push_back(pos);
+        if (pos >= limit) {
+            return false;
+        }
+        pos = elementEnd(pos, end);
+        if (!pos || pos == end) {
+            return true;
+        }
+    }
+}
+
+// Первое смещение в [from, to), с которого подряд разбираются kConfirmElements элементов
+// (или все элементы до конца данных)
+inline const std::byte* guessBoundary(const std::byte* from, const std::byte* to, const std::byte* end) {
+    size_t tried = 0;
+    for (const std::byte* candidate = from; candidate < to; ++candidate) {
+        if (end - candidate < static_cast<std::ptrdiff_t>(sizeof(uint64_t)) ||
+            fromLittleEndian<uint64_t>(candidate) > static_cast<uint64_t>(TypeId::NullableVector)) {
+            continue;
+        }
+        if (++tried > kMaxBoundaryCandidates) {
+            return nullptr;
+        }
+        const std::byte* pos = candidate;
+        size_t parsed = 0;
+        while (parsed < kConfirmElements && pos && pos != end) {
+            pos = elementEnd(pos, end);
+            ++parsed;
+        }
+        if (pos) {
+            return candidate;
+        }
+    }
+    return nullptr;
+}
+
+// Начала count корневых элементов, первый из которых лежит в first; chunks потоков
+inline std::vector<const std::byte*> findRootBoundaries(const std::byte* first, const std::byte* end, uint64_t count,
+                                                        size_t chunks, size_t* repairs = nullptr) {
+    chunks = std::max<size_t>(chunks, 1);
+    size_t span = static_cast<size_t>(end - first);
+    std::vector<const std::byte*> starts(chunks + 1);
+    for (size_t t = 0; t <= chunks; ++t) {
+        starts[t] = first + span / chunks * t;
+    }
+    starts[chunks] = end;
+
+    std::vector<std::vector<const std::byte*>> walks(chunks);
+    std::vector<char> finished(chunks, 0);
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < chunks; ++t) {
+        threads.emplace_back([&, t] {
+            try {
+                const std::byte* begin = t == 0 ? first : guessBoundary(starts[t], starts[t + 1], end);
+                if (begin) {
+                    finished[t] = walk(begin, starts[t + 1], end, walks[t]);
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<const std::byte*> boundaries = std::move(walks[0]);
+    bool done = finished[0];
+    size_t repaired = 0;
+    for (size_t t = 1; t < chunks && !done && !boundaries.empty(); ++t) {
+        const std::byte* known = boundaries.back();
+        if (known >= starts[t + 1]) {
+            continue;  // в куске нет ни одного начала корневого элемента
+        }
+        auto match = std::lower_bound(walks[t].begin(), walks[t].end(), known);
+        if (match != walks[t].end() && *match == known) {
+            boundaries.insert(boundaries.end(), match + 1, walks[t].end());
+            done = finished[t];
+            continue;
+        }
+        ++repaired;
+        std::vector<const std::byte*> tail;
+        done = walk(known, starts[t + 1], end, tail);
+        boundaries.insert(boundaries.end(), tail.begin() + 1, tail.end());
+    }
+    if (repairs) {
+        *repairs = repaired;
+    }
+    if (boundaries.size() < count) {
+        throw std::runtime_error("Not enough data for deserialization");
+    }
+    boundaries.resize(static_cast<size_t>(count));
+    return boundaries;
+}
+
+// То же, что Serializator::deserialize, но корневые элементы ищутся и декодируются в threads потоках
+inline std::vector<Any> deserialize(const Buffer& buffer, size_t threads = 0) {
+    auto begin = buffer.cbegin();
+    auto end = buffer.cend();
+    std::optional<WireHeader> header;
+    if (WireHeader::present(buffer.data(), buffer.size())) {
+        header = WireHeader::parse(buffer.data(), buffer.size());
+        begin += WireHeader::kSize;
+        end = begin + header->bodyLength;
+    }
+    if (std::distance(begin, end) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+        throw std::runtime_error("Not enough data for deserialization");
+    }
+    uint64_t count = fromLittleEndian<uint64_t>(&(*begin));
+    begin += sizeof(uint64_t);
+    size_t bytes = static_cast<size_t>(std::distance(begin, end));
+    if (threads == 0) {
+        threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    threads = std::min<size_t>(threads, std::max<size_t>(bytes / kMinChunkBytes, 1));
+    // Число корней блочной записи заранее неизвестно — делить не на что
+    if (threads == 1 || count < threads || count == kChunkedCount) {
+        return Serializator::deserialize(buffer);
+    }
+
+    const std::byte* data = &(*begin);
+    std::vector<const std::byte*> roots = findRootBoundaries(data, data + bytes, count, threads);
+    std::vector<std::vector<Any>> parts(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            size_t from = roots.size() / threads * t;
+            size_t to = t + 1 == threads ? roots.size() : roots.size() / threads * (t + 1);
+            try {
+                auto decodedEnd = decodeElements(parts[t], to - from, begin + (roots[from] - data), end);
+                // Конец части должен совпасть с найденным началом следующей. Последняя, как и в
+                // Serializator::deserialize, доходит до конца тела только при заголовке: без него хвост
+                // после корней не читается
+                bool last = to == roots.size();
+                if (last ? header && decodedEnd != end : decodedEnd != begin + (roots[to] - data)) {
+                    throw std::runtime_error("Parallel decode boundary mismatch");
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    std::vector<Any> result = std::move(parts[0]);
+    result.reserve(static_cast<size_t>(count));
+    for (size_t t = 1; t < threads; ++t) {
+        std::move(parts[t].begin(), parts[t].end(), std::back_inserter(result));
+    }
+    if (header) {
+        header->checkRootCount(result.size());
+    }
+    return result;
+}
+
+} // namespace parallel
+
+// Возобновляемый декодер: step(budget) разбирает не больше заданного числа элементов, байт или времени
+// и возвращает управление, сохраняя стек вложенных векторов. Вход можно подавать частями через feed:
+// пока данных не хватает, step возвращает NeedMoreData. За один шаг разбирается хотя бы один элемент,
+// поэтому одна длинная строка может превысить бюджет байт.
+//   IncrementalDecoder decoder(std::move(buffer));
+//   while (decoder.step({.elements = 4096}) != IncrementalDecoder::Status::Done) { runOtherWork(); }
+//   std::vector<Any> result = decoder.take();
+class IncrementalDecoder {
+public:
+    struct Budget {
+        uint64_t elements = UINT64_MAX;
+        uint64_t bytes = UINT64_MAX;
+        std::chrono::nanoseconds time = std::chrono::nanoseconds::max();
+    };
+
+    enum class Status { InProgress, NeedMoreData, Done };
+
+    static constexpr size_t kDefaultMaxElementBytes = size_t{1} << 30;
+
+    IncrementalDecoder() = default;
+
+    // Элемент длиннее maxElementBytes считается порчей: иначе без заголовка и finishInput декодер
+    // ждал бы, например, строку с длиной 2^60, бесконечно
+    explicit IncrementalDecoder(size_t maxElementBytes) : maxElementBytes_(maxElementBytes) {}
+
+    // Весь буфер сразу; ввод считается завершённым
+    explicit IncrementalDecoder(Buffer buffer) : input_(std::move(buffer)), inputFinished_(true) {}
+
+    void feed(std::span<const std::byte> data) {
+        if (inputFinished_) {
+            throw std::runtime_error("Decoder input is already finished");
+        }
+        // Разобранное начало выбрасывается, когда оно больше половины буфера: сдвиг стоит не больше
+        // половины уже разобранного. Буфер ограничен неразобранным остатком, а не всем входом, только
+        // если step успевает за feed
+        if (pos_ > input_.size() / 2 && pos_ >= kCompactBytes) {
+            input_.erase(input_.begin(), input_.begin() + static_cast<std::ptrdiff_t>(pos_));
+            if (limit_ != SIZE_MAX) {
+                limit_ -= pos_;
+            }
+            consumedBefore_ += pos_;
+            pos_ = 0;
+        }
+        input_.insert(input_.end(), data.begin(), data.end());
+    }
+
+    // После этого нехватка данных — ошибка, а не ожидание
+    void finishInput() { inputFinished_ = true; }
+
+    Status step(const Budget& budget) {
+        if (state_ == State::Done) {
+            return Status::Done;
+        }
+        if (state_ == State::Start && !readPreamble()) {
+            return needMoreData();
+        }
+        auto deadline = budget.time == std::chrono::nanoseconds::max() ? std::chrono::steady_clock::time_point::max()
+                                                                       : std::chrono::steady_clock::now() + budget.time;
+        size_t start = pos_;
+        uint64_t elements = 0;
+        uint64_t sinceClock = 0;
+        while (true) {
+            Frame& frame = stack_.back();
+            if (frame.remaining == 0 && frame.chunked) {
+                // Заголовок следующего блока; нулевой завершает вектор
+                if (std::min(input_.size(), limit_) - pos_ < sizeof(uint64_t)) {
+                    return needMoreData();
+                }
+                uint64_t chunk = fromLittleEndian<uint64_t>(input_.data() + pos_);
+                pos_ += sizeof(uint64_t);
+                if (chunk == kChunkedCount) {
+                    throw std::runtime_error("Malformed chunked vector");
+                }
+                frame.remaining = chunk;
+                frame.chunked = chunk != 0;
+                continue;
+            }
+            if (frame.remaining == 0) {
+                if (stack_.size() == 1) {
+                    if (header_) {
+                        if (pos_ != limit_) {
+                            throw std::runtime_error("Trailing data in wire body");
+                        }
+                        // Узлы посчитаны по ходу разбора, второго обхода не нужно
+                        header_->checkCounts(frame.elements.size(), elementsDecoded_);
+                    }
+                    state_ = State::Done;
+                    return Status::Done;
+                }
+                VectorType vector(std::move(frame.elements));
+                stack_.pop_back();
+                stack_.back().elements.emplace_back(std::move(vector));
+                continue;
+            }
+            if (elements != 0) {
+                if (elements >= budget.elements || pos_ - start >= budget.bytes) {
+                    return Status::InProgress;
+                }
+                if (sinceClock >= kClockInterval) {
+                    sinceClock = 0;
+                    if (std::chrono::steady_clock::now() >= deadline) {
+                        return Status::InProgress;
+                    }
+                }
+            }
+
+            const std::byte* data = input_.data() + pos_;
+            size_t available = std::min(input_.size(), limit_) - pos_;
+            if (available < sizeof(uint64_t)) {
+                return needMoreData();
+            }
+            uint64_t tag = fromLittleEndian<uint64_t>(data);
+            if (tag > static_cast<uint64_t>(TypeId::NullableVector)) {
+                throw std::runtime_error("Unknown type ID");
+            }
+            auto type = static_cast<TypeId>(tag);
+            if (type == TypeId::Vector) {
+                if (available < 2 * sizeof(uint64_t)) {
+                    return needMoreData();
+                }
+                uint64_t count = fromLittleEndian<uint64_t>(data + sizeof(uint64_t));
+                pos_ += 2 * sizeof(uint64_t);
+                --frame.remaining;
+                stack_.push_back(openFrame(count, available));
+            } else {
+                const std::byte* next = parallel::elementEnd(data, data + available);
+                auto begin = input_.cbegin() + static_cast<std::ptrdiff_t>(pos_);
+                if (!next) {
+                    if (malformedHeader(data, available)) {
+                        throw std::runtime_error("Malformed element header");
+                    }
+                    if (oversized(data, available)) {
+                        throw std::runtime_error("Element exceeds the decoder size limit");
+                    }
+                    if (inputFinished_ || input_.size() >= limit_) {
+                        Any any(IntegerType{});
+                        any.deserialize(begin, begin + static_cast<std::ptrdiff_t>(available));  // точная ошибка
+                    }
+                    return needMoreData();
+                }
+                Any any(IntegerType{});
+                any.deserialize(begin, begin + (next - data));
+                frame.elements.push_back(std::move(any));
+                pos_ += static_cast<size_t>(next - data);
+                --frame.remaining;
+            }
+            ++elements;
+            ++sinceClock;
+            ++elementsDecoded_;
+        }
+    }
+
+    bool done() const { return state_ == State::Done; }
+
+    std::vector<Any> take() {
+        if (!done()) {
+            throw std::runtime_error("Decoding is not finished");
+        }
+        return std::move(stack_.front().elements);
+    }
+
+    uint64_t elementsDecoded() const { return elementsDecoded_; }
+    uint64_t bytesConsumed() const { return consumedBefore_ + pos_; }
+
+private:
+    static constexpr size_t kCompactBytes = 1 << 16;
+    static constexpr uint64_t kClockInterval = 64;
+
+    enum class State { Start, Elements, Done };
+
+    struct Frame {
+        std::vector<Any> elements;
+        uint64_t remaining;
+        bool chunked = false;  // remaining — остаток текущего блока
+    };
+
+    Status needMoreData() const {
+        // Тело с заголовком получено целиком, значит, данных уже не будет
+        if (inputFinished_ || input_.size() >= limit_) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        return Status::NeedMoreData;
+    }
+
+    // Необязательный заголовок и число корневых элементов; ничего не потребляет, пока их не хватает
+    bool readPreamble() {
+        size_t available = input_.size() - pos_;
+        const std::byte* data = input_.data() + pos_;
+        size_t header = 0;
+        if (available >= WireHeader::kMagic.size() && WireHeader::present(data, available)) {
+            if (available < WireHeader::kSize + sizeof(uint64_t)) {
+                return false;
+            }
+            // Тело может быть ещё не получено, поэтому его длина проверяется по мере разбора
+            WireHeader parsed = WireHeader::parseFields(data, available);
+            header_ = parsed;
+            header = WireHeader::kSize;
+            if (parsed.bodyLength > SIZE_MAX - pos_ - header) {
+                throw std::runtime_error("Wire header body is too long");
+            }
+            limit_ = pos_ + header + static_cast<size_t>(parsed.bodyLength);
+        } else if (available < sizeof(uint64_t)) {
+            return false;
+        }
+        uint64_t count = fromLittleEndian<uint64_t>(data + header);
+        pos_ += header + sizeof(uint64_t);
+        stack_.push_back(openFrame(count, available - header));
+        state_ = State::Elements;
+        return true;
+    }
+
+    // Поля, которые делают элемент неразбираемым при любом продолжении данных; elementEnd на них
+    // тоже возвращает nullptr, и без этой проверки декодер ждал бы данных бесконечно
+    static bool malformedHeader(const std::byte* data, size_t available) {
+        auto field = [&](size_t offset) -> std::optional<uint64_t> {
+            if (available < offset + 2 * sizeof(uint64_t)) {
+                return std::nullopt;
+            }
+            return fromLittleEndian<uint64_t>(data + sizeof(uint64_t) + offset);
+        };
+        switch (static_cast<TypeId>(fromLittleEndian<uint64_t>(data))) {
+            case TypeId::Tensor: {
+                auto rank = field(8);
+                if (!rank || *rank > TensorLayout::kMaxRank) {
+                    return rank.has_value();
+                }
+                auto padding = field((4 + 2 * *rank) * sizeof(uint64_t) - 8);
+                return padding && *padding >= TensorLayout::kTensorAlignment;
+            }
+            case TypeId::NullableVector: {
+                auto nullCount = field(8);
+                auto bitCount = field(16);
+                return nullCount && bitCount && *nullCount > *bitCount;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Неразобранный элемент уже длиннее предела или объявляет длину больше него
+    bool oversized(const std::byte* data, size_t available) const {
+        if (available > maxElementBytes_) {
+            return true;
+        }
+        if (available < 2 * sizeof(uint64_t)) {
+            return false;
+        }
+        uint64_t length = fromLittleEndian<uint64_t>(data + sizeof(uint64_t));
+        switch (static_cast<TypeId>(fromLittleEndian<uint64_t>(data))) {
+            case TypeId::String:
+                return length > maxElementBytes_;
+            case TypeId::Bitset:
+                return length / 8 > maxElementBytes_;
+            default:
+                return false;
+        }
+    }
+
+    // Кадр вектора из count элементов; у блочной записи число уточняется по заголовкам блоков
+    static Frame openFrame(uint64_t count, size_t available) {
+        Frame frame{{}, count == kChunkedCount ? 0 : count, count == kChunkedCount};
+        frame.elements.reserve(static_cast<size_t>(std::min<uint64_t>(frame.remaining, available / sizeof(uint64_t))));
+        return frame;
+    }
+
+    Buffer input_;
+    size_t pos_ = 0;
+    size_t limit_ = SIZE_MAX;  // конец тела при наличии заголовка
+    std::optional<WireHeader> header_;
+    uint64_t consumedBefore_ = 0;
+    bool inputFinished_ = false;
+    State state_ = State::Start;
+    std::vector<Frame> stack_;
+    uint64_t elementsDecoded_ = 0;
+    size_t maxElementBytes_ = kDefaultMaxElementBytes;
+};
+
+// Передача сообщения по каналу с ограниченным размером кадра. Fragmenter режет закодированное сообщение
+// на кадры не длиннее maxFrame в произвольных местах, Reassembler отдаёт их части прямо в
+// IncrementalDecoder. Полная копия сообщения на приёме не собирается, пока разбор успевает за приёмом:
+// декодер держит только неразобранный остаток. Если push вызывается с малым бюджетом и resume не
+// догоняет, остаток растёт до размера сообщения. Кадры, пришедшие раньше очереди, ждут пропущенных,
+// повторы отбрасываются.
+namespace fragment {
+
+struct FrameHeader {
+    static constexpr size_t kSize = 32;
+
+    enum Flags : uint64_t {
+        Last = 1 << 0,
+    };
+
+    uint64_t messageId = 0;
+    uint64_t sequence = 0;
+    uint64_t flags = 0;
+    uint64_t payloadLength = 0;
+
+    static FrameHeader parse(std::span<const std::byte> frame) {
+        if (frame.size() < kSize) {
+            throw std::runtime_error("Fragment is shorter than its header");
+        }
+        FrameHeader header;
+        header.messageId = fromLittleEndian<uint64_t>(frame.data());
+        header.sequence = fromLittleEndian<uint64_t>(frame.data() + 8);
+        header.flags = fromLittleEndian<uint64_t>(frame.data() + 16);
+        header.payloadLength = fromLittleEndian<uint64_t>(frame.data() + 24);
+        if (header.flags & ~uint64_t(Last)) {
+            throw std::runtime_error("Unsupported fragment flags");
+        }
+        if (header.payloadLength != frame.size() - kSize) {
+            throw std::runtime_error("Fragment length mismatch");
+        }
+        return header;
+    }
+
+    void writeTo(std::byte* data) const {
+        const uint64_t fields[] = {messageId, sequence, flags, payloadLength};
+        for (size_t i = 0; i < std::size(fields); ++i) {
+            auto le = toLittleEndian(fields[i]);
+            std::copy(le.begin(), le.end(), data + 8 * i);
+        }
+    }
+};
+
+// Кадры по одному; возвращаемый span указывает во внутренний буфер и действителен до следующего next()
+//   fragment::Fragmenter fragmenter(message, 1400, id);
+//   while (auto frame = fragmenter.next()) { socket.send(*frame); }
+class Fragmenter {
+public:
+    Fragmenter(std::span<const std::byte> message, size_t maxFrame, uint64_t messageId)
+        : message_(message), payloadMax_(maxFrame > FrameHeader::kSize ? maxFrame - FrameHeader::kSize : 0),
+          messageId_(messageId) {
+        if (payloadMax_ == 0) {
+            throw std::runtime_error("Frame size must exceed the fragment header");
+        }
+        frame_.reserve(FrameHeader::kSize + std::min(payloadMax_, message_.size()));
+    }
+
+    // Пустое сообщение — один кадр без данных
+    size_t frameCount() const { return std::max<size_t>((message_.size() + payloadMax_ - 1) / payloadMax_, 1); }
+
+    std::optional<std::span<const std::byte>> next() {
+        if (sequence_ == frameCount()) {
+            return std::nullopt;
+        }
+        size_t offset = sequence_ * payloadMax_;
+        size_t length = std::min(payloadMax_, message_.size() - offset);
+        FrameHeader header;
+        header.messageId = messageId_;
+        header.sequence = sequence_;
+        header.flags = sequence_ + 1 == frameCount() ? uint64_t{FrameHeader::Last} : 0;
+        header.payloadLength = length;
+        frame_.resize(FrameHeader::kSize + length);
+        header.writeTo(frame_.data());
+        std::copy_n(message_.begin() + static_cast<std::ptrdiff_t>(offset), length, frame_.begin() + FrameHeader::kSize);
+        ++sequence_;
+        return std::span<const std::byte>(frame_);
+    }
+
+private:
+    std::span<const std::byte> message_;
+    size_t payloadMax_;
+    uint64_t messageId_;
+    uint64_t sequence_ = 0;
+    Buffer frame_;
+};
+
+// Сборка одного сообщения. push разбирает всё, что стало доступно, в пределах budget и возвращает
+// состояние декодера; Done означает, что сообщение получено целиком и его можно забрать через take().
+class Reassembler {
+public:
+    static constexpr size_t kMaxPendingFrames = 1024;
+
+    explicit Reassembler(IncrementalDecoder::Budget budget = {}) : budget_(budget) {}
+
+    IncrementalDecoder::Status push(std::span<const std::byte> frame) {
+        FrameHeader header = FrameHeader::parse(frame);
+        if (!messageId_) {
+            messageId_ = header.messageId;
+        } else if (header.messageId != *messageId_) {
+            throw std::runtime_error("Fragment belongs to another message");
+        }
+        if (lastSequence_ && header.sequence > *lastSequence_) {
+            throw std::runtime_error("Fragment after the last one");
+        }
+        bool last = header.flags & FrameHeader::Last;
+        // Повтор последнего кадра должен нести флаг, как и сохранённый
+        if (lastSequence_ && header.sequence == *lastSequence_ && !last) {
+            throw std::runtime_error("Conflicting last fragment");
+        }
+        if (last) {
+            // Последний кадр один: другой номер либо уже полученный без флага кадр — противоречие
+            if (lastSequence_ ? *lastSequence_ != header.sequence
+                              : header.sequence < nextSequence_ || pending_.count(header.sequence)) {
+                throw std::runtime_error("Conflicting last fragment");
+            }
+            if (!pending_.empty() && pending_.rbegin()->first > header.sequence) {
+                throw std::runtime_error("Fragment after the last one");
+            }
+            lastSequence_ = header.sequence;
+        }
+        std::span<const std::byte> payload = frame.subspan(FrameHeader::kSize);
+        if (header.sequence < nextSequence_ || pending_.count(header.sequence)) {
+            return status_;  // повтор
+        }
+        if (header.sequence > nextSequence_) {
+            if (pending_.size() >= kMaxPendingFrames) {
+                throw std::runtime_error("Too many out-of-order fragments");
+            }
+            pending_.emplace(header.sequence, Buffer(payload.begin(), payload.end()));
+            return status_;
+        }
+        deliver(payload);
+        for (auto it = pending_.begin(); it != pending_.end() && it->first == nextSequence_; it = pending_.erase(it)) {
+            deliver(it->second);
+        }
+        return resume();
+    }
+
+    // Продолжает разбор уже полученных данных, если предыдущий push остановился по бюджету
+    IncrementalDecoder::Status resume() {
+        if (status_ != IncrementalDecoder::Status::Done) {
+            status_ = decoder_.step(budget_);
+        }
+        return status_;
+    }
+
+    bool done() const { return status_ == IncrementalDecoder::Status::Done; }
+
+    std::vector<Any> take() { return decoder_.take(); }
+
+    // Кадров ещё ждём; до прихода последнего их число неизвестно
+    std::optional<uint64_t> missingFrames() const {
+        if (!lastSequence_) {
+            return std::nullopt;
+        }
+        return *lastSequence_ + 1 - nextSequence_ - pending_.size();
+    }
+
+private:
+    void deliver(std::span<const std::byte> payload) {
+        decoder_.feed(payload);
+        if (lastSequence_ && nextSequence_ == *lastSequence_) {
+            decoder_.finishInput();
+        }
+        ++nextSequence_;
+    }
+
+    IncrementalDecoder::Budget budget_;
+    IncrementalDecoder decoder_;
+    IncrementalDecoder::Status status_ = IncrementalDecoder::Status::NeedMoreData;
+    std::optional<uint64_t> messageId_;
+    std::optional<uint64_t> lastSequence_;
+    uint64_t nextSequence_ = 0;
+    std::map<uint64_t, Buffer> pending_;  // кадры, пришедшие раньше очереди
+};
+
+} // namespace fragment
+
+// Кэш декодированных сообщений по содержимому: ключ — 128-битный отпечаток закодированных байт,
+// значение — общее неизменяемое дерево. Отпечаток не криптографический, поэтому запись хранит копию
+// закодированных байт и попадание подтверждается их сравнением. Объём ограничен суммой memoryFootprint
+// деревьев и копий; вытеснение по алгоритму CLOCK в каждом из шардов со своей блокировкой.
+// Декодирование идёт вне блокировки.
+class DecodeCache {
+public:
+    using Value = std::shared_ptr<const std::vector<Any>>;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+    explicit DecodeCache(size_t capacityBytes, size_t shardCount = 16)
+        : shards_(std::max<size_t>(shardCount, 1)),
+          shardCapacity_(capacityBytes / std::max<size_t>(shardCount, 1)) {}
+
+    // Дерево из кэша либо результат Serializator::deserialize, сохранённый для следующих вызовов
+    Value decode(const Buffer& buffer) {
+        Key key = fingerprint(buffer.data(), buffer.size());
+        Shard& shard = shardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (Value value = shard.find(key, buffer)) {
+                ++shard.hits;
+                return value;
+            }
+            ++shard.misses;
+        }
+        auto decoded = std::make_shared<std::vector<Any>>(Serializator::deserialize(buffer));
+        size_t bytes = memoryFootprint(*decoded) + buffer.size();
+        Value value = std::move(decoded);
+        // Дерево больше доли шарда не кэшируется, иначе оно вытеснило бы всё остальное
+        if (bytes > shardCapacity_) {
+            return value;
+        }
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.insert(key, buffer, std::move(value), bytes, shardCapacity_);
+    }
+
+    Value find(const Buffer& buffer) {
+        Key key = fingerprint(buffer.data(), buffer.size());
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.find(key, buffer);
+    }
+
+    Stats stats() const {
+        Stats total;
+        for (const Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            total.hits += shard.hits;
+            total.misses += shard.misses;
+            total.evictions += shard.evictions;
+            total.entries += shard.index.size();
+            total.bytes += shard.bytes;
+        }
+        return total;
+    }
+
+    void clear() {
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.index.clear();
+            shard.slots.clear();
+            shard.freeSlots.clear();
+            shard.bytes = 0;
+            shard.hand = 0;
+        }
+    }
+
+private:
+    using Key = std::array<uint64_t, 2>;
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const { return static_cast<size_t>(key[0]); }
+    };
+
+    struct Slot {
+        Key key{};
+        Buffer encoded;  // сверяется при попадании: совпадение отпечатков ещё не равенство
+        Value value;
+        size_t bytes = 0;
+        bool referenced = false;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<Key, size_t, KeyHash> index;  // ключ -> номер слота
+        std::vector<Slot> slots;
+        std::vector<size_t> freeSlots;                    // номера пустых слотов (value == nullptr)
+        size_t bytes = 0;
+        size_t hand = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+
+        Value find(const Key& key, const Buffer& buffer) {
+            auto it = index.find(key);
+            if (it == index.end()) {
+                return nullptr;
+            }
+            Slot& slot = slots[it->second];
+            if (slot.encoded.size() != buffer.size() ||
+                (!buffer.empty() && std::memcmp(slot.encoded.data(), buffer.data(), buffer.size()) != 0)) {
+                return nullptr;
+            }
+            slot.referenced = true;
+            return slot.value;
+        }
+
+        // Пока не хватает места, стрелка снимает отметки обращения и вытесняет неотмеченные записи
+        Value insert(const Key& key, const Buffer& buffer, Value value, size_t size, size_t capacity) {
+            if (Value existing = find(key, buffer)) {
+                return existing;
+            }
+            // Другое сообщение с тем же отпечатком: запись остаётся, новое дерево не кэшируется
+            if (index.count(key)) {
+                return value;
+            }
+            while (bytes + size > capacity && !index.empty()) {
+                size_t current = hand;
+                Slot& slot = slots[current];
+                hand = (hand + 1) % slots.size();
+                if (!slot.value) {
+                    continue;
+                }
+                if (slot.referenced) {
+                    slot.referenced = false;
+                    continue;
+                }
+                index.erase(slot.key);
+                bytes -= slot.bytes;
+                slot = Slot();
+                freeSlots.push_back(current);
+                ++evictions;
+            }
+            size_t at = slots.size();
+            if (!freeSlots.empty()) {
+                at = freeSlots.back();
+                freeSlots.pop_back();
+            } else {
+                slots.emplace_back();
+            }
+            slots[at] = Slot{key, buffer, value, size, false};
+            index.emplace(key, at);
+            bytes += size;
+            return value;
+        }
+    };
+
+    // Два независимых прохода умножения со сдвигом по 8-байтовым словам за один проход по данным
+    static Key fingerprint(const std::byte* data, size_t size) {
+        constexpr uint64_t kMulA = 0x9E3779B97F4A7C15ULL;
+        constexpr uint64_t kMulB = 0xC2B2AE3D27D4EB4FULL;
+        uint64_t a = size ^ 0x243F6A8885A308D3ULL;
+        uint64_t b = size ^ 0x13198A2E03707344ULL;
+        auto mix = [&](uint64_t word) {
+            a = std::rotl((a ^ word) * kMulA, 31);
+            b = std::rotl((b + word) * kMulB, 29) ^ a;
+        };
+        size_t i = 0;
+        for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            mix(word);
+        }
+        uint64_t tail = 0;
+        if (size > i) {
+            std::memcpy(&tail, data + i, size - i);
+        }
+        mix(tail);
+        auto finalize = [](uint64_t h) {
+            h ^= h >> 33;
+            h *= 0xFF51AFD7ED558CCDULL;
+            h ^= h >> 33;
+            return h;
+        };
+        return {finalize(a), finalize(b)};
+    }
+
+    Shard& shardFor(const Key& key) { return shards_[key[1] % shards_.size()]; }
+
+    std::vector<Shard> shards_;
+    size_t shardCapacity_;
+};
+
+// Образ для отображения в память: данные читаются на месте, без разбора.
+// Заголовок (32 байта): магия, версия, число корневых элементов, смещение корневого массива.
+// Каждый элемент — узел из двух 8-байтовых слов, выровненный на 8:
+//   слово 0: TypeId в младшем байте, длина строки или число элементов вектора в старших 56 битах;
+//   слово 1: значение Uint/Float либо смещение данных строки/массива детей относительно начала узла.
+// Дети вектора лежат подряд, строки дополнены до кратной 8 длины, поэтому образ перемещаем как есть.
+// Однородный вектор Uint/Float может быть упакован: младший байт слова 0 равен kPackedFlag | TypeId
+// элементов, а слово 1 указывает на выровненный массив голых 8-байтовых значений.
+// Прочие типы хранятся как их полезная нагрузка формата Serializator: длина в слове 0, смещение в слове 1.
+namespace image {
+
+constexpr std::array<char, 8> kMagic = {'S', 'R', 'Z', 'I', 'M', 'G', '\0', '\1'};
+constexpr uint64_t kVersion = 1;
+constexpr size_t kHeaderSize = 32;
+constexpr size_t kNodeSize = 16;
+constexpr uint64_t kPackedFlag = 0x80;
+
+// Упаковываются только 8-байтовые значения; другой тип элементов в образе — порча данных
+inline TypeId checkPackedType(TypeId type) {
+    if (type != TypeId::Uint && type != TypeId::Float) {
+        throw std::runtime_error("Packed image array must hold Uint or Float values");
+    }
+    return type;
+}
+
+class Vector;
+
+// Узел образа с тем же интерфейсом чтения, что у Any.
+// Элемент упакованного массива представлен тем же классом: у него есть только значение и тип.
+class Value {
+public:
+    Value(const std::byte* base, size_t size, size_t offset, std::optional<TypeId> packed = std::nullopt)
+        : base_(base), size_(size), offset_(offset), packed_(packed) {
+        if (packed_) {
+            checkPackedType(*packed_);
+        }
+        if (offset_ % 8 != 0 || offset_ > size_ || size_ - offset_ < (packed_ ? 8 : kNodeSize)) {
+            throw std::runtime_error("Image node out of bounds");
+        }
+    }
+
+    TypeId getPayloadTypeId() const {
+        if (packed_) {
+            return *packed_;
+        }
+        uint64_t tag = word(0) & 0xFF;
+        return (tag & kPackedFlag) ? TypeId::Vector : static_cast<TypeId>(tag);
+    }
+
+    bool isPacked() const { return !packed_ && (word(0) & kPackedFlag); }
+
+    // IntegerType -> uint64_t, FloatType -> double, StringType -> std::string_view, VectorType -> image::Vector,
+    // BoolType -> bool, BitsetType -> bits::View; остальные типы декодируются из полезной нагрузки
+    template<typename T>
+    auto getValue() const {
+        if constexpr (std::is_same_v<T, IntegerType>) {
+            expect(TypeId::Uint);
+            return scalar();
+        } else if constexpr (std::is_same_v<T, FloatType>) {
+            expect(TypeId::Float);
+            uint64_t raw = scalar();
+            double value;
+            std::memcpy(&value, &raw, sizeof(value));
+            return value;
+        } else if constexpr (std::is_same_v<T, StringType>) {
+            expect(TypeId::String);
+            size_t at = target(length());
+            return std::string_view(reinterpret_cast<const char*>(base_ + at), length());
+        } else if constexpr (std::is_same_v<T, VectorType>) {
+            expect(TypeId::Vector);
+            if (isPacked()) {
+                return Vector(base_, size_, target(length() * 8), length(), packedElementType());
+            }
+            return Vector(base_, size_, target(length() * kNodeSize), length());
+        } else if constexpr (std::is_same_v<T, BoolType>) {
+            expect(TypeId::Bool);
+            std::span<const std::byte> bytes = payload();
+            if (bytes.size() != 1) {
+                throw std::runtime_error("Malformed Bool node in image");
+            }
+            return bytes.front() != std::byte{0};
+        } else if constexpr (std::is_same_v<T, BitsetType>) {
+            expect(TypeId::Bitset);
+            std::span<const std::byte> bytes = payload();
+            bits::View view = bits::View::fromPayload(bytes.data(), bytes.size());
+            if (!view.trailingBitsClear()) {
+                throw std::runtime_error("Bitset has bits set past its size");
+            }
+            return view;
+        } else {
+            Any any = toAny();
+            return T(any.getValue<T>());
+        }
+    }
+
+    // Полезная нагрузка формата Serializator для типов без собственной раскладки в образе
+    std::span<const std::byte> payload() const {
+        if (packed_ || getPayloadTypeId() <= TypeId::Vector) {
+            throw std::runtime_error("Image node has no embedded payload");
+        }
+        return std::span<const std::byte>(base_ + target(length()), static_cast<size_t>(length()));
+    }
+
+    // Упакованный массив без копирования: IntegerType -> span<const uint64_t>, FloatType -> span<const double>.
+    // Требует little-endian платформу и выравнивание данных в памяти (mmap выравнивает на страницу).
+    template<typename T>
+    auto getArray() const {
+        using Element = std::conditional_t<std::is_same_v<T, IntegerType>, uint64_t, double>;
+        static_assert(std::is_same_v<T, IntegerType> || std::is_same_v<T, FloatType>, "Unsupported array type");
+        if (!isPacked() || packedElementType() != (std::is_same_v<T, IntegerType> ? TypeId::Uint : TypeId::Float)) {
+            throw std::runtime_error("Image node is not a packed array of requested type");
+        }
+        if constexpr (std::endian::native != std::endian::little) {
+            throw std::runtime_error("In-place arrays require a little-endian host");
+        }
+        const std::byte* data = base_ + target(length() * sizeof(Element));
+        if (reinterpret_cast<uintptr_t>(data) % alignof(Element) != 0) {
+            throw std::runtime_error("Packed array is misaligned in memory");
+        }
+        return std::span<const Element>(reinterpret_cast<const Element*>(data), static_cast<size_t>(length()));
+    }
+
+    // Обратное преобразование в обычное дерево
+    Any toAny() const;
+
+private:
+    uint64_t word(size_t index) const {
+        return fromLittleEndian<uint64_t>(base_ + offset_ + index * 8);
+    }
+
+    uint64_t length() const { return word(0) >> 8; }
+
+    uint64_t scalar() const { return packed_ ? fromLittleEndian<uint64_t>(base_ + offset_) : word(1); }
+
+    TypeId packedElementType() const { return checkPackedType(static_cast<TypeId>(word(0) & 0xFF & ~kPackedFlag)); }
+
+    void expect(TypeId type) const {
+        if (getPayloadTypeId() != type) {
+            throw std::runtime_error("Image node type mismatch");
+        }
+    }
+
+    // Абсолютное смещение данных узла с проверкой, что bytes байт помещаются в образ
+    size_t target(uint64_t bytes) const {
+        uint64_t relative = word(1);
+        if (relative > size_ - offset_ || bytes > size_ - offset_ - relative) {
+            throw std::runtime_error("Image offset out of bounds");
+        }
+        return offset_ + static_cast<size_t>(relative);
+    }
+
+    const std::byte* base_;
+    size_t size_;
+    size_t offset_;
+    std::optional<TypeId> packed_;
+};
+
+// Массив подряд лежащих узлов (дети вектора или корень образа) либо упакованных значений
+class Vector {
+public:
+    Vector(const std::byte* base, size_t size, size_t offset, uint64_t count,
+           std::optional<TypeId> packed = std::nullopt)
+        : base_(base), size_(size), offset_(offset), count_(count), packed_(packed) {
+        if (packed_) {
+            checkPackedType(*packed_);
+        }
+    }
+
+    size_t size() const { return static_cast<size_t>(count_); }
+
+    Value operator[](size_t index) const {
+        if (index >= count_) {
+            throw std::runtime_error("Image vector index out of range");
+        }
+        return Value(base_, size_, offset_ + index * (packed_ ? 8 : kNodeSize), packed_);
+    }
+
+private:
+    const std::byte* base_;
+    size_t size_;
+    size_t offset_;
+    uint64_t count_;
+    std::optional<TypeId> packed_;
+};
+
+// Образ поверх чужой памяти (буфер или отображённый файл); проверяет только заголовок
+class View {
+public:
+    View(const std::byte* data, size_t size) : data_(data), size_(size) {
+        if (size_ < kHeaderSize || !std::equal(kMagic.begin(), kMagic.end(), reinterpret_cast<const char*>(data_))) {
+            throw std::runtime_error("Not a serialized image");
+        }
+        if (fromLittleEndian<uint64_t>(data_ + 8) != kVersion) {
+            throw std::runtime_error("Unsupported image version");
+        }
+        count_ = fromLittleEndian<uint64_t>(data_ + 16);
+        rootOffset_ = fromLittleEndian<uint64_t>(data_ + 24);
+        if (rootOffset_ > size_ || count_ > (size_ - rootOffset_) / kNodeSize) {
+            throw std::runtime_error("Image root out of bounds");
+        }
+    }
+
+    explicit View(const Buffer& buffer) : View(buffer.data(), buffer.size()) {}
+
+    size_t size() const { return static_cast<size_t>(count_); }
+
+    Value operator[](size_t index) const { return root()[index]; }
+
+    Vector root() const { return Vector(data_, size_, static_cast<size_t>(rootOffset_), count_); }
+
+private:
+    const std::byte* data_;
+    size_t size_;
+    uint64_t count_ = 0;
+    uint64_t rootOffset_ = 0;
+};
+
+inline Any Value::toAny() const {
+    switch (getPayloadTypeId()) {
+        case TypeId::Uint:
+            return Any(IntegerType(getValue<IntegerType>()));
+        case TypeId::Float:
+            return Any(FloatType(getValue<FloatType>()));
+        case TypeId::String:
+            return Any(StringType(std::string(getValue<StringType>())));
+        case TypeId::Vector: {
+            Vector children = getValue<VectorType>();
+            VectorType vector;
+            for (size_t i = 0; i < children.size(); ++i) {
+                vector.push_back(children[i].toAny());
+            }
+            return Any(std::move(vector));
+        }
+        default: {
+            auto tagLe = toLittleEndian(static_cast<uint64_t>(getPayloadTypeId()));
+            Buffer wire(tagLe.begin(), tagLe.end());
+            std::span<const std::byte> bytes = payload();
+            wire.insert(wire.end(), bytes.begin(), bytes.end());
+            Any any(IntegerType{});
+            any.deserialize(wire.cbegin(), wire.cend());
+            return any;
+        }
+    }
+}
+
+// Преобразование формата Serializator в образ за один проход, без построения Any
+class Writer {
+public:
+    struct Options {
+        bool packNumericVectors = false;  // упаковывать однородные векторы Uint/Float
+        size_t alignment = 8;             // выравнивание упакованных массивов от начала образа (8 или 64)
+    };
+
+    static Buffer fromWire(const Buffer& wire) {
+        return fromWire(wire, Options());
+    }
+
+    static Buffer fromWire(const Buffer& wire, const Options& options) {
+        if (options.alignment < 8 || (options.alignment & (options.alignment - 1)) != 0) {
+            throw std::runtime_error("Image alignment must be a power of two not less than 8");
+        }
+        Writer writer(wire, options);
+        auto begin = wire.cbegin();
+        std::optional<uint64_t> rootCount;
+        if (WireHeader::present(wire.data(), wire.size())) {
+            WireHeader header = WireHeader::parse(wire.data(), wire.size());
+            begin += WireHeader::kSize;
+            writer.end_ = begin + header.bodyLength;
+            // nodeCapacity не больше bodyLength / 8, так что произведение не переполняется
+            writer.image_.reserve(kHeaderSize + static_cast<size_t>(header.nodeCapacity()) * kNodeSize + header.bodyLength);
+            rootCount = header.rootCount;
+        }
+        uint64_t declared = writer.readUint(begin);
+        uint64_t count = writer.elementCount(begin, declared);
+        if (rootCount && *rootCount != count) {
+            throw std::runtime_error("Wire header counts do not match the body");
+        }
+        writer.image_.resize(kHeaderSize);
+        std::copy(kMagic.begin(), kMagic.end(), reinterpret_cast<char*>(writer.image_.data()));
+        writer.patch(8, kVersion);
+        writer.patch(16, count);
+        writer.patch(24, kHeaderSize);
+        writer.writeArray(begin, count, declared == kChunkedCount);
+        return std::move(writer.image_);
+    }
+
+private:
+    Writer(const Buffer& wire, const Options& options) : end_(wire.cend()), options_(options) {}
+
+    // Тип элементов, если все count элементов начиная с it — скаляры одного типа
+    std::optional<TypeId> homogeneousScalars(Buffer::const_iterator it, uint64_t count) const {
+        if (count == 0 || count > static_cast<uint64_t>(std::distance(it, end_)) / (2 * sizeof(uint64_t))) {
+            return std::nullopt;
+        }
+        uint64_t first = fromLittleEndian<uint64_t>(&(*it));
+        if (first != static_cast<uint64_t>(TypeId::Uint) && first != static_cast<uint64_t>(TypeId::Float)) {
+            return std::nullopt;
+        }
+        if (scalarRunLength(&(*it), static_cast<size_t>(count)) != count) {
+            return std::nullopt;
+        }
+        return static_cast<TypeId>(first);
+    }
+
+    uint64_t readUint(Buffer::const_iterator& it) const {
+        if (std::distance(it, end_) < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t value = fromLittleEndian<uint64_t>(&(*it));
+        it += sizeof(uint64_t);
+        return value;
+    }
+
+    void patch(size_t offset, uint64_t value) {
+        auto le = toLittleEndian(value);
+        std::copy(le.begin(), le.end(), image_.begin() + offset);
+    }
+
+    // Узлы вектора в образе лежат подряд, поэтому число элементов блочной записи считается заранее
+    uint64_t elementCount(Buffer::const_iterator it, uint64_t declared) const {
+        return declared == kChunkedCount ? parallel::chunkedLength(std::to_address(it), std::to_address(end_)) : declared;
+    }
+
+    // Резервирует count узлов подряд и заполняет их; данные детей дописываются в конец образа.
+    // У блочной записи (chunked) заголовки блоков пропускаются
+    void writeArray(Buffer::const_iterator& it, uint64_t count, bool chunked) {
+        if (count > static_cast<uint64_t>(std::distance(it, end_)) / sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        size_t nodes = image_.size();
+        image_.resize(nodes + count * kNodeSize);
+        uint64_t inChunk = chunked ? 0 : count;
+        for (uint64_t i = 0; i < count; ++i) {
+            if (inChunk == 0) {
+                inChunk = readUint(it);
+            }
+            --inChunk;
+            size_t node = nodes + i * kNodeSize;
+            auto type = static_cast<TypeId>(readUint(it));
+            switch (type) {
+                case TypeId::Uint:
+                case TypeId::Float:
+                    patch(node, static_cast<uint64_t>(type));
+                    patch(node + 8, readUint(it));
+                    break;
+                case TypeId::String: {
+                    uint64_t length = readUint(it);
+                    if (static_cast<uint64_t>(std::distance(it, end_)) < length) {
+                        throw std::runtime_error("Not enough data for deserialization");
+                    }
+                    size_t at = image_.size();
+                    image_.insert(image_.end(), it, it + length);
+                    image_.resize((image_.size() + 7) & ~size_t{7});
+                    it += length;
+                    patch(node, static_cast<uint64_t>(type) | (length << 8));
+                    patch(node + 8, at - node);
+                    break;
+                }
+                case TypeId::Vector: {
+                    uint64_t declared = readUint(it);
+                    uint64_t length = elementCount(it, declared);
+                    bool chunked = declared == kChunkedCount;
+                    std::optional<TypeId> packed =
+                        options_.packNumericVectors && !chunked ? homogeneousScalars(it, length) : std::nullopt;
+                    if (packed) {
+                        size_t at = (image_.size() + options_.alignment - 1) & ~(options_.alignment - 1);
+                        image_.resize(at + length * sizeof(uint64_t));
+                        for (uint64_t k = 0; k < length; ++k) {
+                            it += sizeof(uint64_t);
+                            std::copy(it, it + sizeof(uint64_t), image_.begin() + at + k * sizeof(uint64_t));
+                            it += sizeof(uint64_t);
+                        }
+                        patch(node, (kPackedFlag | static_cast<uint64_t>(*packed)) | (length << 8));
+                        patch(node + 8, at - node);
+                        break;
+                    }
+                    patch(node, static_cast<uint64_t>(type) | (length << 8));
+                    patch(node + 8, image_.size() - node);
+                    writeArray(it, length, chunked);
+                    break;
+                }
+                default: {
+                    // Границу полезной нагрузки находит parallel::elementEnd, не строя Any;
+                    // содержимое проверяется при чтении узла
+                    auto tag = it - sizeof(uint64_t);
+                    const std::byte* start = &(*tag);
+                    const std::byte* stop = parallel::elementEnd(start, start + std::distance(tag, end_));
+                    if (!stop) {
+                        Any any(IntegerType{});
+                        any.deserialize(tag, end_);  // точная ошибка
+                        throw std::runtime_error("Malformed element in serialized data");
+                    }
+                    auto next = tag + (stop - start);
+                    uint64_t length = static_cast<uint64_t>(std::distance(it, next));
+                    size_t at = image_.size();
+                    image_.insert(image_.end(), it, next);
+                    image_.resize((image_.size() + 7) & ~size_t{7});
+                    it = next;
+                    patch(node, static_cast<uint64_t>(type) | (length << 8));
+                    patch(node + 8, at - node);
+                    break;
+                }
+            }
+        }
+        if (chunked) {
+            readUint(it);  // завершающий пустой блок, проверен в chunkedLength
+        }
+    }
+
+    Buffer::const_iterator end_;
+    Options options_;
+    Buffer image_;
+};
+
+// Обратное преобразование образа в формат Serializator
+inline void toWire(const Vector& nodes, Buffer& buffer) {
+    auto sizeLe = toLittleEndian(static_cast<uint64_t>(nodes.size()));
+    buffer.insert(buffer.end(), sizeLe.begin(), sizeLe.end());
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        Value value = nodes[i];
+        auto tagLe = toLittleEndian(static_cast<uint64_t>(value.getPayloadTypeId()));
+        buffer.insert(buffer.end(), tagLe.begin(), tagLe.end());
+        switch (value.getPayloadTypeId()) {
+            case TypeId::Uint:
+                IntegerType(value.getValue<IntegerType>()).serialize(buffer);
+                break;
+            case TypeId::Float:
+                FloatType(value.getValue<FloatType>()).serialize(buffer);
+                break;
+            case TypeId::String: {
+                std::string_view str = value.getValue<StringType>();
+                auto lengthLe = toLittleEndian(static_cast<uint64_t>(str.size()));
+                buffer.insert(buffer.end(), lengthLe.begin(), lengthLe.end());
+                buffer.insert(buffer.end(), reinterpret_cast<const std::byte*>(str.data()),
+                              reinterpret_cast<const std::byte*>(str.data() + str.size()));
+                break;
+            }
+            case TypeId::Vector:
+                toWire(value.getValue<VectorType>(), buffer);
+                break;
+            default: {
+                std::span<const std::byte> bytes = value.payload();
+                buffer.insert(buffer.end(), bytes.begin(), bytes.end());
+                break;
+            }
+        }
+    }
+}
+
+inline Buffer toWire(const View& view) {
+    Buffer buffer;
+    toWire(view.root(), buffer);
+    return buffer;
+}
+
+} // namespace image
+
+// Потоковый перевод между форматом Serializator и JSON без промежуточного дерева Any.
+// Корень — массив корневых элементов. Uint — целое, Float — кратчайшая запись с точкой или
+// экспонентой (std::to_chars), String — строка (байты UTF-8 копируются как есть), Vector — массив,
+// Bool — true/false, Null — null. Остальные типы, нечисловые Float и строки не в UTF-8 передаются как
+// {"$wire":"<base64 тега и полезной нагрузки>"}, так что обратный перевод восстанавливает буфер побайтно.
+namespace json {
+
+constexpr std::string_view kWireKey = "$wire";
+constexpr char kBase64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Длина префикса, который можно скопировать в строку JSON без экранирования
+inline size_t plainPrefix(const char* data, size_t size) {
+    size_t i = 0;
+#ifdef __AVX2__
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i special = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(special));
+        if (mask != 0) {
+            return i + static_cast<size_t>(std::countr_zero(mask));
+        }
+    }
+#endif
+    // SWAR по 8 байт: слово без '"', '\\' и байтов < 0x20 пропускается целиком
+    constexpr uint64_t kOnes = 0x0101010101010101ULL;
+    constexpr uint64_t kHigh = 0x8080808080808080ULL;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        uint64_t quotes = word ^ (kOnes * '"');
+        uint64_t backslashes = word ^ (kOnes * '\\');
+        uint64_t flagged = ((quotes - kOnes) & ~quotes) | ((backslashes - kOnes) & ~backslashes) |
+                           ((word - kOnes * 0x20) & ~word);
+        if ((flagged & kHigh) != 0) {
+            break;
+        }
+    }
+    for (; i < size; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c == '"' || c == '\\' || c < 0x20) {
+            break;
+        }
+    }
+    return i;
+}
+
+// Корректный UTF-8 (RFC 3629): без избыточных форм, суррогатов и кодов выше U+10FFFF
+inline bool validUtf8(const char* data, size_t size) {
+    auto byte = [data](size_t i) { return static_cast<unsigned char>(data[i]); };
+    size_t i = 0;
+    while (i < size) {
+        // ASCII пропускается словами по 8 байт
+        if (i + 8 <= size) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char lead = byte(i);
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+        size_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+        if (lead < 0xC2 || lead > 0xF4 || size - i < length) {
+            return false;
+        }
+        // Допустимый диапазон второго байта отсекает избыточные формы, суррогаты и коды выше U+10FFFF
+        unsigned char low = lead == 0xE0 ? 0xA0 : lead == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = lead == 0xED ? 0x9F : lead == 0xF4 ? 0x8F : 0xBF;
+        if (byte(i + 1) < low || byte(i + 1) > high) {
+            return false;
+        }
+        for (size_t k = 2; k < length; ++k) {
+            if ((byte(i + k) & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+// Вывод накапливается в строке и сбрасывается в поток крупными блоками
+class Encoder {
+public:
+    static constexpr size_t kFlushBytes = 1 << 20;
+
+    explicit Encoder(std::ostream* sink = nullptr) : sink_(sink) {}
+
+    // Добавляет JSON для буфера wire (заголовок WireHeader пропускается)
+    void encode(const Buffer& wire) {
+        wire_ = &wire;
+        const std::byte* pos = wire.data();
+        end_ = wire.data() + wire.size();
+        if (WireHeader::present(wire.data(), wire.size())) {
+            WireHeader header = WireHeader::parse(wire.data(), wire.size());
+            pos += WireHeader::kSize;
+            end_ = pos + header.bodyLength;
+            out_.reserve(std::min<uint64_t>(header.bodyLength * 2, kFlushBytes * 2));
+        }
+        uint64_t count = readUint(pos);
+        writeArray(pos, count);
+        flush();
+    }
+
+    void flush() {
+        if (sink_ && !out_.empty()) {
+            sink_->write(out_.data(), static_cast<std::streamsize>(out_.size()));
+            out_.clear();
+        }
+    }
+
+    const std::string& str() const { return out_; }
+
+private:
+    uint64_t readUint(const std::byte*& pos) const {
+        if (end_ - pos < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t value = fromLittleEndian<uint64_t>(pos);
+        pos += sizeof(uint64_t);
+        return value;
+    }
+
+    // Длина массива в JSON не пишется, так что блоки блочной записи просто идут подряд
+    void writeArray(const std::byte*& pos, uint64_t count) {
+        out_.push_back('[');
+        bool first = true;
+        if (count == kChunkedCount) {
+            for (uint64_t chunk = readUint(pos); chunk != 0; chunk = readUint(pos)) {
+                if (chunk == kChunkedCount) {
+                    throw std::runtime_error("Malformed chunked vector");
+                }
+                writeElements(pos, chunk, first);
+            }
+        } else {
+            writeElements(pos, count, first);
+        }
+        out_.push_back(']');
+    }
+
+    void writeElements(const std::byte*& pos, uint64_t count, bool& first) {
+        if (count > static_cast<uint64_t>(end_ - pos) / sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            if (!first) {
+                out_.push_back(',');
+            }
+            first = false;
+            writeValue(pos);
+            if (out_.size() >= kFlushBytes) {
+                flush();
+            }
+        }
+    }
+
+    void writeValue(const std::byte*& pos) {
+        const std::byte* element = pos;
+        auto type = static_cast<TypeId>(readUint(pos));
+        switch (type) {
+            case TypeId::Uint: {
+                char digits[24];
+                auto result = std::to_chars(digits, digits + sizeof(digits), readUint(pos));
+                out_.append(digits, result.ptr);
+                return;
+            }
+            case TypeId::Float: {
+                uint64_t raw = readUint(pos);
+                double value;
+                std::memcpy(&value, &raw, sizeof(value));
+                if (!std::isfinite(value)) {
+                    break;
+                }
+                char digits[32];
+                auto result = std::to_chars(digits, digits + sizeof(digits), value);
+                out_.append(digits, result.ptr);
+                // Без точки и экспоненты число прочиталось бы обратно как Uint
+                if (std::find_if(digits, result.ptr, [](char c) { return c == '.' || c == 'e'; }) == result.ptr) {
+                    out_.append(".0");
+                }
+                return;
+            }
+            case TypeId::String: {
+                uint64_t length = readUint(pos);
+                if (static_cast<uint64_t>(end_ - pos) < length) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                // Байты не в UTF-8 в строке JSON не выразить, они уходят в $wire
+                if (!validUtf8(reinterpret_cast<const char*>(pos), length)) {
+                    break;
+                }
+                writeString(reinterpret_cast<const char*>(pos), length);
+                pos += length;
+                return;
+            }
+            case TypeId::Vector:
+                writeArray(pos, readUint(pos));
+                return;
+            case TypeId::Bool:
+                if (pos == end_) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                out_.append(*pos++ != std::byte{0} ? "true" : "false");
+                return;
+            case TypeId::Null:
+                out_.append("null");
+                return;
+            default:
+                break;
+        }
+        // Границу полезной нагрузки находит обычный декодер
+        Any any(IntegerType{});
+        auto begin = wire_->cbegin() + (element - wire_->data());
+        pos = wire_->data() + std::distance(wire_->cbegin(), any.deserialize(begin, wire_->cbegin() + (end_ - wire_->data())));
+        out_.append("{\"");
+        out_.append(kWireKey);
+        out_.append("\":\"");
+        writeBase64(element, static_cast<size_t>(pos - element));
+        out_.append("\"}");
+    }
+
+    void writeString(const char* data, size_t size) {
+        static constexpr char kHex[] = "0123456789abcdef";
+        out_.push_back('"');
+        while (size > 0) {
+            size_t plain = plainPrefix(data, size);
+            out_.append(data, plain);
+            data += plain;
+            size -= plain;
+            if (size == 0) {
+                break;
+            }
+            unsigned char c = static_cast<unsigned char>(*data++);
+            --size;
+            switch (c) {
+                case '"': out_.append("\\\""); break;
+                case '\\': out_.append("\\\\"); break;
+                case '\n': out_.append("\\n"); break;
+                case '\r': out_.append("\\r"); break;
+                case '\t': out_.append("\\t"); break;
+                default: {
+                    const char escape[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+                    out_.append(escape, sizeof(escape));
+                    break;
+                }
+            }
+        }
+        out_.push_back('"');
+    }
+
+    void writeBase64(const std::byte* data, size_t size) {
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3) {
+            uint32_t group = (std::to_integer<uint32_t>(data[i]) << 16) |
+                             (std::to_integer<uint32_t>(data[i + 1]) << 8) | std::to_integer<uint32_t>(data[i + 2]);
+            const char chars[] = {kBase64[group >> 18], kBase64[(group >> 12) & 63], kBase64[(group >> 6) & 63],
+                                  kBase64[group & 63]};
+            out_.append(chars, sizeof(chars));
+        }
+        if (i < size) {
+            uint32_t group = std::to_integer<uint32_t>(data[i]) << 16;
+            if (i + 1 < size) {
+                group |= std::to_integer<uint32_t>(data[i + 1]) << 8;
+            }
+            out_.push_back(kBase64[group >> 18]);
+            out_.push_back(kBase64[(group >> 12) & 63]);
+            out_.push_back(i + 1 < size ? kBase64[(group >> 6) & 63] : '=');
+            out_.push_back('=');
+        }
+    }
+
+    std::ostream* sink_;
+    std::string out_;
+    const Buffer* wire_ = nullptr;
+    const std::byte* end_ = nullptr;
+};
+
+inline std::string fromWire(const Buffer& wire) {
+    Encoder encoder;
+    encoder.encode(wire);
+    return encoder.str();
+}
+
+inline void fromWire(const Buffer& wire, std::ostream& out) {
+    Encoder encoder(&out);
+    encoder.encode(wire);
+}
+
+// Разбор JSON прямо в формат Serializator; длины векторов и строк дописываются по завершении
+class Decoder {
+public:
+    static Buffer toWire(std::string_view text, bool withHeader = false) {
+        Decoder decoder(text);
+        if (withHeader) {
+            decoder.out_.resize(WireHeader::kSize);
+        }
+        decoder.out_.reserve(text.size());
+        decoder.skipSpace();
+        if (decoder.pos_ == decoder.end_ || *decoder.pos_ != '[') {
+            throw std::runtime_error("JSON root must be an array");
+        }
+        uint64_t roots = decoder.readArray();
+        decoder.skipSpace();
+        if (decoder.pos_ != decoder.end_) {
+            throw std::runtime_error("Unexpected data after JSON root");
+        }
+        if (withHeader) {
+            WireHeader header;
+            header.rootCount = roots;
+            header.totalCount = decoder.nodes_;
+            header.bodyLength = decoder.out_.size() - WireHeader::kSize;
+            header.writeTo(decoder.out_.data());
+        }
+        return std::move(decoder.out_);
+    }
+
+private:
+    explicit Decoder(std::string_view text)
+        : start_(text.data()), pos_(text.data()), end_(text.data() + text.size()) {}
+
+    [[noreturn]] void fail(const char* what) const {
+        throw std::runtime_error(std::string(what) + " at JSON offset " + std::to_string(pos_ - start_));
+    }
+
+    void skipSpace() {
+        while (pos_ != end_ && (*pos_ == ' ' || *pos_ == '\n' || *pos_ == '\r' || *pos_ == '\t')) {
+            ++pos_;
+        }
+    }
+
+    void expect(char c) {
+        skipSpace();
+        if (pos_ == end_ || *pos_ != c) {
+            fail("Malformed JSON");
+        }
+        ++pos_;
+    }
+
+    void putUint(uint64_t value) {
+        auto le = toLittleEndian(value);
+        out_.insert(out_.end(), le.begin(), le.end());
+    }
+
+    void patchUint(size_t at, uint64_t value) {
+        auto le = toLittleEndian(value);
+        std::copy(le.begin(), le.end(), out_.begin() + at);
+    }
+
+    // Пишет элементы массива (без тега) и возвращает их число
+    uint64_t readArray() {
+        expect('[');
+        size_t countAt = out_.size();
+        putUint(0);
+        uint64_t count = 0;
+        skipSpace();
+        if (pos_ != end_ && *pos_ == ']') {
+            ++pos_;
+            return 0;
+        }
+        while (true) {
+            readValue();
+            ++count;
+            skipSpace();
+            if (pos_ != end_ && *pos_ == ',') {
+                ++pos_;
+                continue;
+            }
+            expect(']');
+            break;
+        }
+        patchUint(countAt, count);
+        return count;
+    }
+
+    void readValue() {
+        skipSpace();
+        if (pos_ == end_) {
+            fail("Unexpected end of JSON");
+        }
+        ++nodes_;
+        switch (*pos_) {
+            case '[':
+                putUint(static_cast<uint64_t>(TypeId::Vector));
+                readArray();
+                return;
+            case '"': {
+                putUint(static_cast<uint64_t>(TypeId::String));
+                size_t lengthAt = out_.size();
+                putUint(0);
+                readString();
+                patchUint(lengthAt, out_.size() - lengthAt - sizeof(uint64_t));
+                return;
+            }
+            case '{':
+                readWireObject();
+                return;
+            case 't':
+            case 'f': {
+                bool value = *pos_ == 't';
+                readLiteral(value ? "true" : "false");
+                putUint(static_cast<uint64_t>(TypeId::Bool));
+                out_.push_back(static_cast<std::byte>(value ? 1 : 0));
+                return;
+            }
+            case 'n':
+                readLiteral("null");
+                putUint(static_cast<uint64_t>(TypeId::Null));
+                return;
+            default:
+                readNumber();
+                return;
+        }
+    }
+
+    void readLiteral(std::string_view literal) {
+        if (static_cast<size_t>(end_ - pos_) < literal.size() || std::string_view(pos_, literal.size()) != literal) {
+            fail("Malformed JSON literal");
+        }
+        pos_ += literal.size();
+    }
+
+    size_t skipDigits() {
+        const char* from = pos_;
+        while (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9') {
+            ++pos_;
+        }
+        return static_cast<size_t>(pos_ - from);
+    }
+
+    // Грамматика RFC 8259: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+    // Целое без знака и дробной части — Uint, иначе Float
+    void readNumber() {
+        const char* start = pos_;
+        bool integral = true;
+        if (pos_ != end_ && *pos_ == '-') {
+            integral = false;
+            ++pos_;
+        }
+        if (pos_ != end_ && *pos_ == '0') {
+            ++pos_;
+            if (pos_ != end_ && *pos_ >= '0' && *pos_ <= '9') {
+                fail("Leading zeros in JSON number");
+            }
+        } else if (skipDigits() == 0) {
+            fail("Malformed JSON number");
+        }
+        if (pos_ != end_ && *pos_ == '.') {
+            integral = false;
+            ++pos_;
+            if (skipDigits() == 0) {
+                fail("Malformed JSON number");
+            }
+        }
+        if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E')) {
+            integral = false;
+            ++pos_;
+            if (pos_ != end_ && (*pos_ == '+' || *pos_ == '-')) {
+                ++pos_;
+            }
+            if (skipDigits() == 0) {
+                fail("Malformed JSON number");
+            }
+        }
+        if (integral) {
+            uint64_t value;
+            auto result = std::from_chars(start, pos_, value);
+            if (result.ec == std::errc() && result.ptr == pos_) {
+                putUint(static_cast<uint64_t>(TypeId::Uint));
+                putUint(value);
+                return;
+            }
+        }
+        double value;
+        auto result = std::from_chars(start, pos_, value);
+        if (result.ec != std::errc() || result.ptr != pos_) {
+            fail("Malformed JSON number");
+        }
+        uint64_t raw;
+        std::memcpy(&raw, &value, sizeof(raw));
+        putUint(static_cast<uint64_t>(TypeId::Float));
+        putUint(raw);
+    }
+
+    static int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    uint32_t readHex4() {
+        if (end_ - pos_ < 4) {
+            fail("Malformed JSON escape");
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hexDigit(*pos_++);
+            if (digit < 0) {
+                fail("Malformed JSON escape");
+            }
+            value = (value << 4) | static_cast<uint32_t>(digit);
+        }
+        return value;
+    }
+
+    void putUtf8(uint32_t code) {
+        auto put = [this](uint32_t byte) { out_.push_back(static_cast<std::byte>(byte)); };
+        if (code < 0x80) {
+            put(code);
+        } else if (code < 0x800) {
+            put(0xC0 | (code >> 6));
+            put(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            put(0xE0 | (code >> 12));
+            put(0x80 | ((code >> 6) & 0x3F));
+            put(0x80 | (code & 0x3F));
+        } else {
+            put(0xF0 | (code >> 18));
+            put(0x80 | ((code >> 12) & 0x3F));
+            put(0x80 | ((code >> 6) & 0x3F));
+            put(0x80 | (code & 0x3F));
+        }
+    }
+
+    // Раскодированные байты строки дописываются в out_; участки без '"', '\\' и управляющих байтов
+    // копируются целиком
+    void readString() {
+        expect('"');
+        while (true) {
+            const char* stop = pos_ + plainPrefix(pos_, static_cast<size_t>(end_ - pos_));
+            out_.insert(out_.end(), reinterpret_cast<const std::byte*>(pos_), reinterpret_cast<const std::byte*>(stop));
+            pos_ = stop;
+            if (pos_ == end_) {
+                fail("Unterminated JSON string");
+            }
+            if (static_cast<unsigned char>(*pos_) < 0x20) {
+                fail("Unescaped control character in JSON string");
+            }
+            if (*pos_++ == '"') {
+                return;
+            }
+            if (pos_ == end_) {
+                fail("Unterminated JSON string");
+            }
+            char c = *pos_++;
+            switch (c) {
+                case '"': case '\\': case '/': out_.push_back(static_cast<std::byte>(c)); break;
+                case 'b': out_.push_back(std::byte{'\b'}); break;
+                case 'f': out_.push_back(std::byte{'\f'}); break;
+                case 'n': out_.push_back(std::byte{'\n'}); break;
+                case 'r': out_.push_back(std::byte{'\r'}); break;
+                case 't': out_.push_back(std::byte{'\t'}); break;
+                case 'u': {
+                    uint32_t code = readHex4();
+                    // Одиночный суррогат не кодируется в UTF-8
+                    if (code >= 0xDC00 && code < 0xE000) {
+                        fail("Unpaired JSON surrogate");
+                    }
+                    if (code >= 0xD800 && code < 0xDC00) {
+                        if (end_ - pos_ < 6 || pos_[0] != '\\' || pos_[1] != 'u') {
+                            fail("Unpaired JSON surrogate");
+                        }
+                        pos_ += 2;
+                        uint32_t low = readHex4();
+                        if (low < 0xDC00 || low >= 0xE000) {
+                            fail("Malformed JSON surrogate pair");
+                        }
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    putUtf8(code);
+                    break;
+                }
+                default:
+                    fail("Malformed JSON escape");
+            }
+        }
+    }
+
+    // Допускается только {"$wire":"..."}: байты одного элемента не-вектора вставляются как есть.
+    // Границу проверяет parallel::elementEnd без построения Any, содержимое — декодер буфера.
+    void readWireObject() {
+        expect('{');
+        skipSpace();
+        size_t keyAt = out_.size();
+        readString();
+        bool wireKey = std::equal(out_.begin() + keyAt, out_.end(), kWireKey.begin(), kWireKey.end(),
+                                  [](std::byte b, char c) { return b == static_cast<std::byte>(c); });
+        out_.resize(keyAt);
+        if (!wireKey) {
+            fail("JSON objects other than {\"$wire\":...} are not supported");
+        }
+        expect(':');
+        skipSpace();
+        if (pos_ == end_ || *pos_ != '"') {
+            fail("Malformed $wire value");
+        }
+        ++pos_;
+        uint32_t group = 0;
+        int bitsHeld = 0;
+        for (; pos_ != end_ && *pos_ != '"'; ++pos_) {
+            if (*pos_ == '=') {
+                continue;
+            }
+            const char* digit = std::find(kBase64, kBase64 + 64, *pos_);
+            if (digit == kBase64 + 64) {
+                fail("Malformed $wire value");
+            }
+            group = (group << 6) | static_cast<uint32_t>(digit - kBase64);
+            bitsHeld += 6;
+            if (bitsHeld >= 8) {
+                bitsHeld -= 8;
+                out_.push_back(static_cast<std::byte>((group >> bitsHeld) & 0xFF));
+            }
+        }
+        expect('"');
+        expect('}');
+        // Векторы в JSON — массивы, так что $wire всегда один узел
+        const std::byte* element = out_.data() + keyAt;
+        const std::byte* stop = out_.data() + out_.size();
+        if (out_.size() - keyAt < sizeof(uint64_t) ||
+            fromLittleEndian<uint64_t>(element) == static_cast<uint64_t>(TypeId::Vector) ||
+            parallel::elementEnd(element, stop) != stop) {
+            fail("Malformed $wire value");
+        }
+    }
+
+    const char* start_;
+    const char* pos_;
+    const char* end_;
+    uint64_t nodes_ = 0;
+    Buffer out_;
+};
+
+inline Buffer toWire(std::string_view text, bool withHeader = false) {
+    return Decoder::toWire(text, withHeader);
+}
+
+} // namespace json
+
+// Общие части переводчиков MessagePack и CBOR: обход буфера Serializator с выдачей событий формату
+// и построение буфера Serializator из разобранных значений. Деревья Any не строятся.
+namespace transcode {
+
+inline void putLe64(Buffer& out, uint64_t value) {
+    size_t at = out.size();
+    out.resize(at + sizeof(uint64_t));
+    for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+        out[at + i] = static_cast<std::byte>(value >> (8 * i));
+    }
+}
+
+inline void putBe(Buffer& out, uint64_t value, size_t bytes) {
+    size_t at = out.size();
+    out.resize(at + bytes);
+    for (size_t i = 0; i < bytes; ++i) {
+        out[at + i] = static_cast<std::byte>(value >> (8 * (bytes - 1 - i)));
+    }
+}
+
+inline uint64_t getBe(const std::byte* data, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value = (value << 8) | std::to_integer<uint64_t>(data[i]);
+    }
+    return value;
+}
+
+inline void putBytes(Buffer& out, const std::byte* data, size_t size) {
+    size_t at = out.size();
+    out.resize(at + size);
+    if (size != 0) {
+        std::memcpy(out.data() + at, data, size);
+    }
+}
+
+// Format задаёт статические putUint, putFloat (сырые биты double), putString, putArray (заголовок),
+// putBool, putNull и putExtension(тип, полезная нагрузка) для прочих типов
+template<typename Format>
+class WireSource {
+public:
+    static Buffer run(const Buffer& wire) {
+        WireSource source(wire);
+        const std::byte* pos = wire.data();
+        if (WireHeader::present(wire.data(), wire.size())) {
+            WireHeader header = WireHeader::parse(wire.data(), wire.size());
+            pos += WireHeader::kSize;
+            source.end_ = pos + header.bodyLength;
+        }
+        source.out_.reserve(static_cast<size_t>(source.end_ - pos));
+        source.writeArray(pos, source.readUint(pos));
+        return std::move(source.out_);
+    }
+
+private:
+    explicit WireSource(const Buffer& wire) : wire_(wire), end_(wire.data() + wire.size()) {}
+
+    uint64_t readUint(const std::byte*& pos) const {
+        if (end_ - pos < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t value = fromLittleEndian<uint64_t>(pos);
+        pos += sizeof(uint64_t);
+        return value;
+    }
+
+    void writeArray(const std::byte*& pos, uint64_t count) {
+        if (count == kChunkedCount) {
+            // Формату длина нужна до элементов: блоки сначала считаются, затем пишутся подряд
+            Format::putArray(out_, parallel::chunkedLength(pos, end_));
+            for (uint64_t chunk = readUint(pos); chunk != 0; chunk = readUint(pos)) {
+                for (uint64_t i = 0; i < chunk; ++i) {
+                    writeValue(pos);
+                }
+            }
+            return;
+        }
+        if (count > static_cast<uint64_t>(end_ - pos) / sizeof(uint64_t)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        Format::putArray(out_, count);
+        for (uint64_t i = 0; i < count; ++i) {
+            writeValue(pos);
+        }
+    }
+
+    void writeValue(const std::byte*& pos) {
+        auto type = static_cast<TypeId>(readUint(pos));
+        switch (type) {
+            case TypeId::Uint:
+                Format::putUint(out_, readUint(pos));
+                return;
+            case TypeId::Float:
+                Format::putFloat(out_, readUint(pos));
+                return;
+            case TypeId::String: {
+                uint64_t length = readUint(pos);
+                if (static_cast<uint64_t>(end_ - pos) < length) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                Format::putString(out_, pos, length);
+                pos += length;
+                return;
+            }
+            case TypeId::Vector:
+                writeArray(pos, readUint(pos));
+                return;
+            case TypeId::Bool:
+                if (pos == end_) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                Format::putBool(out_, *pos++ != std::byte{0});
+                return;
+            case TypeId::Null:
+                Format::putNull(out_);
+                return;
+            default: {
+                // Границу полезной нагрузки находит обычный декодер
+                Any any(IntegerType{});
+                auto element = wire_.cbegin() + (pos - sizeof(uint64_t) - wire_.data());
+                const std::byte* next =
+                    wire_.data() + std::distance(wire_.cbegin(), any.deserialize(element, wire_.cbegin() + (end_ - wire_.data())));
+                Format::putExtension(out_, type, pos, static_cast<size_t>(next - pos));
+                pos = next;
+                return;
+            }
+        }
+    }
+
+    const Buffer& wire_;
+    const std::byte* end_;
+    Buffer out_;
+};
+
+// Построитель буфера Serializator; счётчики векторов переписываются после разбора детей
+class WireSink {
+public:
+    explicit WireSink(bool withHeader, size_t expectedSize) : withHeader_(withHeader) {
+        out_.reserve(expectedSize + WireHeader::kSize);
+        if (withHeader_) {
+            out_.resize(WireHeader::kSize);
+        }
+    }
+
+    void putUint(uint64_t value) {
+        node(TypeId::Uint);
+        putLe64(out_, value);
+    }
+
+    void putFloat(double value) {
+        uint64_t raw;
+        std::memcpy(&raw, &value, sizeof(raw));
+        node(TypeId::Float);
+        putLe64(out_, raw);
+    }
+
+    void putString(const std::byte* data, size_t size) {
+        node(TypeId::String);
+        putLe64(out_, size);
+        putBytes(out_, data, size);
+    }
+
+    // Строка из нескольких частей: открыть, дописать части, закрыть
+    size_t openString() {
+        node(TypeId::String);
+        size_t at = out_.size();
+        putLe64(out_, 0);
+        return at;
+    }
+
+    void appendString(const std::byte* data, size_t size) { putBytes(out_, data, size); }
+
+    void closeString(size_t at) { patch(at, out_.size() - at - sizeof(uint64_t)); }
+
+    void putBool(bool value) {
+        node(TypeId::Bool);
+        out_.push_back(static_cast<std::byte>(value ? 1 : 0));
+    }
+
+    void putNull() { node(TypeId::Null); }
+
+    // Полезная нагрузка прочего типа проверяется обычным декодером и вставляется как есть.
+    // Uint, Float, String и Vector у форматов свои; в расширении они дали бы вектор с неучтёнными узлами.
+    void putExtension(TypeId type, const std::byte* data, size_t size) {
+        if (type <= TypeId::Vector) {
+            throw std::runtime_error("Extension must not carry a core type");
+        }
+        size_t at = out_.size();
+        node(type);
+        putBytes(out_, data, size);
+        Any any(IntegerType{});
+        if (any.deserialize(out_.cbegin() + at, out_.cend()) != out_.cend()) {
+            throw std::runtime_error("Malformed extension payload");
+        }
+    }
+
+    // Корень открывается без тега, вложенный вектор — с тегом
+    size_t openArray(bool root = false) {
+        if (!root) {
+            node(TypeId::Vector);
+        }
+        size_t at = out_.size();
+        putLe64(out_, 0);
+        return at;
+    }
+
+    void closeArray(size_t at, uint64_t count) { patch(at, count); }
+
+    Buffer finish(uint64_t rootCount) {
+        if (withHeader_) {
+            WireHeader header;
+            header.rootCount = rootCount;
+            header.totalCount = nodes_;
+            header.bodyLength = out_.size() - WireHeader::kSize;
+            header.writeTo(out_.data());
+        }
+        return std::move(out_);
+    }
+
+private:
+    void node(TypeId type) {
+        ++nodes_;
+        putLe64(out_, static_cast<uint64_t>(type));
+    }
+
+    void patch(size_t at, uint64_t value) {
+        for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+            out_[at + i] = static_cast<std::byte>(value >> (8 * i));
+        }
+    }
+
+    bool withHeader_;
+    uint64_t nodes_ = 0;
+    Buffer out_;
+};
+
+// Курсор по входному буферу чужого формата
+struct Input {
+    const std::byte* pos;
+    const std::byte* end;
+
+    const std::byte* take(uint64_t size) {
+        if (static_cast<uint64_t>(end - pos) < size) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        const std::byte* data = pos;
+        pos += size;
+        return data;
+    }
+
+    uint8_t byte() { return std::to_integer<uint8_t>(*take(1)); }
+    uint64_t be(size_t bytes) { return getBe(take(bytes), bytes); }
+};
+
+} // namespace transcode
+
+// MessagePack: Uint — положительное целое минимальной ширины, Float — float 64, String — str,
+// Vector — array, Bool/Null — true/false/nil. Прочие типы — ext с кодом TypeId и полезной нагрузкой.
+// При чтении отрицательные целые и float 32 становятся Float, bin — String; map не поддерживается.
+namespace msgpack {
+
+struct Format {
+    static void putUint(Buffer& out, uint64_t value) {
+        if (value < 0x80) {
+            out.push_back(static_cast<std::byte>(value));
+        } else if (value <= 0xFF) {
+            out.push_back(std::byte{0xCC});
+            transcode::putBe(out, value, 1);
+        } else if (value <= 0xFFFF) {
+            out.push_back(std::byte{0xCD});
+            transcode::putBe(out, value, 2);
+        } else if (value <= 0xFFFFFFFF) {
+            out.push_back(std::byte{0xCE});
+            transcode::putBe(out, value, 4);
+        } else {
+            out.push_back(std::byte{0xCF});
+            transcode::putBe(out, value, 8);
+        }
+    }
+
+    static void putFloat(Buffer& out, uint64_t raw) {
+        out.push_back(std::byte{0xCB});
+        transcode::putBe(out, raw, 8);
+    }
+
+    static void putString(Buffer& out, const std::byte* data, uint64_t size) {
+        if (size < 32) {
+            out.push_back(static_cast<std::byte>(0xA0 | size));
+        } else if (size <= 0xFF) {
+            out.push_back(std::byte{0xD9});
+            transcode::putBe(out, size, 1);
+        } else if (size <= 0xFFFF) {
+            out.push_back(std::byte{0xDA});
+            transcode::putBe(out, size, 2);
+        } else if (size <= 0xFFFFFFFF) {
+            out.push_back(std::byte{0xDB});
+            transcode::putBe(out, size, 4);
+        } else {
+            throw std::runtime_error("String is too long for MessagePack");
+        }
+        transcode::putBytes(out, data, size);
+    }
+
+    static void putArray(Buffer& out, uint64_t count) {
+        if (count < 16) {
+            out.push_back(static_cast<std::byte>(0x90 | count));
+        } else if (count <= 0xFFFF) {
+            out.push_back(std::byte{0xDC});
+            transcode::putBe(out, count, 2);
+        } else if (count <= 0xFFFFFFFF) {
+            out.push_back(std::byte{0xDD});
+            transcode::putBe(out, count, 4);
+        } else {
+            throw std::runtime_error("Vector is too long for MessagePack");
+        }
+    }
+
+    static void putBool(Buffer& out, bool value) { out.push_back(std::byte{static_cast<uint8_t>(value ? 0xC3 : 0xC2)}); }
+
+    static void putNull(Buffer& out) { out.push_back(std::byte{0xC0}); }
+
+    static void putExtension(Buffer& out, TypeId type, const std::byte* data, size_t size) {
+        static constexpr uint8_t kFixExt[] = {0, 0xD4, 0xD5, 0, 0xD6, 0, 0, 0, 0xD7};
+        if (size == 16) {
+            out.push_back(std::byte{0xD8});
+        } else if (size <= 8 && kFixExt[size] != 0) {
+            out.push_back(std::byte{kFixExt[size]});
+        } else if (size <= 0xFF) {
+            out.push_back(std::byte{0xC7});
+            transcode::putBe(out, size, 1);
+        } else if (size <= 0xFFFF) {
+            out.push_back(std::byte{0xC8});
+            transcode::putBe(out, size, 2);
+        } else if (size <= 0xFFFFFFFF) {
+            out.push_back(std::byte{0xC9});
+            transcode::putBe(out, size, 4);
+        } else {
+            throw std::runtime_error("Payload is too long for MessagePack");
+        }
+        out.push_back(static_cast<std::byte>(type));
+        transcode::putBytes(out, data, size);
+    }
+};
+
+inline Buffer fromWire(const Buffer& wire) {
+    return transcode::WireSource<Format>::run(wire);
+}
+
+class Reader {
+public:
+    static Buffer toWire(const std::byte* data, size_t size, bool withHeader = false) {
+        Reader reader(data, size, withHeader);
+        uint8_t lead = reader.in_.byte();
+        uint64_t count;
+        if ((lead & 0xF0) == 0x90) {
+            count = lead & 0x0F;
+        } else if (lead == 0xDC || lead == 0xDD) {
+            count = reader.in_.be(lead == 0xDC ? 2 : 4);
+        } else {
+            throw std::runtime_error("MessagePack root must be an array");
+        }
+        size_t at = reader.sink_.openArray(true);
+        for (uint64_t i = 0; i < count; ++i) {
+            reader.readValue();
+        }
+        reader.sink_.closeArray(at, count);
+        if (reader.in_.pos != reader.in_.end) {
+            throw std::runtime_error("Unexpected data after MessagePack root");
+        }
+        return reader.sink_.finish(count);
+    }
+
+private:
+    Reader(const std::byte* data, size_t size, bool withHeader)
+        : in_{data, data + size}, sink_(withHeader, size * 2) {}
+
+    void readArray(uint64_t count) {
+        if (count > static_cast<uint64_t>(in_.end - in_.pos)) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        size_t at = sink_.openArray();
+        for (uint64_t i = 0; i < count; ++i) {
+            readValue();
+        }
+        sink_.closeArray(at, count);
+    }
+
+    void readSigned(int64_t value) {
+        if (value >= 0) {
+            sink_.putUint(static_cast<uint64_t>(value));
+        } else {
+            sink_.putFloat(static_cast<double>(value));
+        }
+    }
+
+    void readExtension(uint64_t size) {
+        auto type = static_cast<TypeId>(in_.byte());
+        sink_.putExtension(type, in_.take(size), size);
+    }
+
+    void readValue() {
+        uint8_t lead = in_.byte();
+        if (lead < 0x80) {
+            sink_.putUint(lead);
+            return;
+        }
+        if (lead >= 0xE0) {
+            sink_.putFloat(static_cast<double>(static_cast<int8_t>(lead)));
+            return;
+        }
+        if ((lead & 0xE0) == 0xA0) {
+            uint64_t size = lead & 0x1F;
+            sink_.putString(in_.take(size), size);
+            return;
+        }
+        if ((lead & 0xF0) == 0x90) {
+            readArray(lead & 0x0F);
+            return;
+        }
+        switch (lead) {
+            case 0xC0: sink_.putNull(); return;
+            case 0xC2: sink_.putBool(false); return;
+            case 0xC3: sink_.putBool(true); return;
+            case 0xC4: case 0xC5: case 0xC6:
+            case 0xD9: case 0xDA: case 0xDB: {
+                size_t width = lead <= 0xC6 ? size_t{1} << (lead - 0xC4) : size_t{1} << (lead - 0xD9);
+                uint64_t size = in_.be(width);
+                sink_.putString(in_.take(size), size);
+                return;
+            }
+            case 0xC7: readExtension(in_.be(1)); return;
+            case 0xC8: readExtension(in_.be(2)); return;
+            case 0xC9: readExtension(in_.be(4)); return;
+            case 0xCA: {
+                uint32_t raw = static_cast<uint32_t>(in_.be(4));
+                float value;
+                std::memcpy(&value, &raw, sizeof(value));
+                sink_.putFloat(value);
+                return;
+            }
+            case 0xCB: {
+                uint64_t raw = in_.be(8);
+                double value;
+                std::memcpy(&value, &raw, sizeof(value));
+                sink_.putFloat(value);
+                return;
+            }
+            case 0xCC: sink_.putUint(in_.be(1)); return;
+            case 0xCD: sink_.putUint(in_.be(2)); return;
+            case 0xCE: sink_.putUint(in_.be(4)); return;
+            case 0xCF: sink_.putUint(in_.be(8)); return;
+            case 0xD0: readSigned(static_cast<int8_t>(in_.be(1))); return;
+            case 0xD1: readSigned(static_cast<int16_t>(in_.be(2))); return;
+            case 0xD2: readSigned(static_cast<int32_t>(in_.be(4))); return;
+            case 0xD3: readSigned(static_cast<int64_t>(in_.be(8))); return;
+            case 0xD4: readExtension(1); return;
+            case 0xD5: readExtension(2); return;
+            case 0xD6: readExtension(4); return;
+            case 0xD7: readExtension(8); return;
+            case 0xD8: readExtension(16); return;
+            case 0xDC: readArray(in_.be(2)); return;
+            case 0xDD: readArray(in_.be(4)); return;
+            default:
+                throw std::runtime_error("Unsupported MessagePack type");
+        }
+    }
+
+    transcode::Input in_;
+    transcode::WireSink sink_;
+};
+
+inline Buffer toWire(const std::byte* data, size_t size, bool withHeader = false) {
+    return Reader::toWire(data, size, withHeader);
+}
+
+} // namespace msgpack
+
+// CBOR (RFC 8949): Uint — major 0, Float — float 64, String — текстовая строка, Vector — массив,
+// Bool/Null — простые значения. Прочие типы — тег kExtensionTag + TypeId над байтовой строкой
+// полезной нагрузки. При чтении допускаются массивы и строки неопределённой длины, отрицательные
+// целые и float 16/32 (становятся Float), байтовые строки (становятся String) и прочие теги (пропускаются).
+namespace cbor {
+
+constexpr uint64_t kExtensionTag = 0x53525A00;  // "SRZ\0"
+
+struct Format {
+    static void putHead(Buffer& out, uint8_t major, uint64_t value) {
+        uint8_t type = static_cast<uint8_t>(major << 5);
+        if (value < 24) {
+            out.push_back(static_cast<std::byte>(type | value));
+        } else if (value <= 0xFF) {
+            out.push_back(static_cast<std::byte>(type | 24));
+            transcode::putBe(out, value, 1);
+        } else if (value <= 0xFFFF) {
+            out.push_back(static_cast<std::byte>(type | 25));
+            transcode::putBe(out, value, 2);
+        } else if (value <= 0xFFFFFFFF) {
+            out.push_back(static_cast<std::byte>(type | 26));
+            transcode::putBe(out, value, 4);
+        } else {
+            out.push_back(static_cast<std::byte>(type | 27));
+            transcode::putBe(out, value, 8);
+        }
+    }
+
+    static void putUint(Buffer& out, uint64_t value) { putHead(out, 0, value); }
+
+    static void putFloat(Buffer& out, uint64_t raw) {
+        out.push_back(std::byte{0xFB});
+        transcode::putBe(out, raw, 8);
+    }
+
+    static void putString(Buffer& out, const std::byte* data, uint64_t size) {
+        putHead(out, 3, size);
+        transcode::putBytes(out, data, size);
+    }
+
+    static void putArray(Buffer& out, uint64_t count) { putHead(out, 4, count); }
+
+    static void putBool(Buffer& out, bool value) { out.push_back(std::byte{static_cast<uint8_t>(value ? 0xF5 : 0xF4)}); }
+
+    static void putNull(Buffer& out) { out.push_back(std::byte{0xF6}); }
+
+    static void putExtension(Buffer& out, TypeId type, const std::byte* data, size_t size) {
+        putHead(out, 6, kExtensionTag + static_cast<uint64_t>(type));
+        putHead(out, 2, size);
+        transcode::putBytes(out, data, size);
+    }
+};
+
+inline Buffer fromWire(const Buffer& wire) {
+    return transcode::WireSource<Format>::run(wire);
+}
+
+class Reader {
+public:
+    static Buffer toWire(const std::byte* data, size_t size, bool withHeader = false) {
+        Reader reader(data, size, withHeader);
+        uint8_t lead = reader.in_.byte();
+        if ((lead >> 5) != 4) {
+            throw std::runtime_error("CBOR root must be an array");
+        }
+        uint64_t count = reader.readArray(lead & 0x1F, true);
+        if (reader.in_.pos != reader.in_.end) {
+            throw std::runtime_error("Unexpected data after CBOR root");
+        }
+        return reader.sink_.finish(count);
+    }
+
+private:
+    static constexpr uint8_t kIndefinite = 31;
+    static constexpr std::byte kBreak{0xFF};
+
+    Reader(const std::byte* data, size_t size, bool withHeader)
+        : in_{data, data + size}, sink_(withHeader, size * 2) {}
+
+    uint64_t readArgument(uint8_t info) {
+        if (info < 24) {
+            return info;
+        }
+        if (info > 27) {
+            throw std::runtime_error("Malformed CBOR argument");
+        }
+        return in_.be(size_t{1} << (info - 24));
+    }
+
+    uint64_t readArray(uint8_t info, bool root = false) {
+        size_t at = sink_.openArray(root);
+        uint64_t count = 0;
+        if (info == kIndefinite) {
+            while (in_.pos != in_.end && *in_.pos != kBreak) {
+                readValue();
+                ++count;
+            }
+            in_.take(1);
+        } else {
+            count = readArgument(info);
+            if (count > static_cast<uint64_t>(in_.end - in_.pos)) {
+                throw std::runtime_error("Not enough data for deserialization");
+            }
+            for (uint64_t i = 0; i < count; ++i) {
+                readValue();
+            }
+        }
+        sink_.closeArray(at, count);
+        return count;
+    }
+
+    // Строка неопределённой длины — последовательность определённых частей того же major до break
+    void readString(uint8_t major, uint8_t info) {
+        if (info != kIndefinite) {
+            uint64_t size = readArgument(info);
+            sink_.putString(in_.take(size), size);
+            return;
+        }
+        size_t at = sink_.openString();
+        while (in_.pos == in_.end || *in_.pos != kBreak) {
+            uint8_t chunk = in_.byte();
+            if ((chunk >> 5) != major || (chunk & 0x1F) == kIndefinite) {
+                throw std::runtime_error("Malformed CBOR string chunk");
+            }
+            uint64_t size = readArgument(chunk & 0x1F);
+            sink_.appendString(in_.take(size), size);
+        }
+        in_.take(1);
+        sink_.closeString(at);
+    }
+
+    static double halfToDouble(uint16_t half) {
+        int exponent = (half >> 10) & 0x1F;
+        double mantissa = half & 0x3FF;
+        double value = exponent == 0    ? std::ldexp(mantissa, -24)
+                       : exponent == 31 ? (mantissa == 0 ? INFINITY : NAN)
+                                        : std::ldexp(mantissa + 1024, exponent - 25);
+        return (half & 0x8000) ? -value : value;
+    }
+
+    void readValue() {
+        uint8_t lead = in_.byte();
+        uint8_t major = lead >> 5;
+        uint8_t info = lead & 0x1F;
+        switch (major) {
+            case 0:
+                sink_.putUint(readArgument(info));
+                return;
+            case 1:
+                sink_.putFloat(-1.0 - static_cast<double>(readArgument(info)));
+                return;
+            case 2:
+            case 3:
+                readString(major, info);
+                return;
+            case 4:
+                readArray(info);
+                return;
+            case 5:
+                throw std::runtime_error("CBOR maps are not supported");
+            case 6: {
+                uint64_t tag = readArgument(info);
+                if (tag > kExtensionTag && tag - kExtensionTag < 256) {
+                    uint8_t bytes = in_.byte();
+                    if ((bytes >> 5) != 2 || (bytes & 0x1F) == kIndefinite) {
+                        throw std::runtime_error("Malformed CBOR extension");
+                    }
+                    uint64_t size = readArgument(bytes & 0x1F);
+                    sink_.putExtension(static_cast<TypeId>(tag - kExtensionTag), in_.take(size), size);
+                    return;
+                }
+                readValue();
+                return;
+            }
+            default:
+                break;
+        }
+        switch (info) {
+            case 20: sink_.putBool(false); return;
+            case 21: sink_.putBool(true); return;
+            case 22:
+            case 23: sink_.putNull(); return;
+            case 25: sink_.putFloat(halfToDouble(static_cast<uint16_t>(in_.be(2)))); return;
+            case 26: {
+                uint32_t raw = static_cast<uint32_t>(in_.be(4));
+                float value;
+                std::memcpy(&value, &raw, sizeof(value));
+                sink_.putFloat(value);
+                return;
+            }
+            case 27: {
+                uint64_t raw = in_.be(8);
+                double value;
+                std::memcpy(&value, &raw, sizeof(value));
+                sink_.putFloat(value);
+                return;
+            }
+            default:
+                throw std::runtime_error("Unsupported CBOR simple value");
+        }
+    }
+
+    transcode::Input in_;
+    transcode::WireSink sink_;
+};
+
+inline Buffer toWire(const std::byte* data, size_t size, bool withHeader = false) {
+    return Reader::toWire(data, size, withHeader);
+}
+
+} // namespace cbor
+
+// Выгрузка в поток Arrow IPC (формат метаданных V5) без внешних зависимостей.
+// Данные должны быть записями: каждый корневой элемент — VectorType с одинаковым числом полей
+// Uint, Float, String или Null. Поле становится столбцом UInt64, Float64, Utf8 (или Null, если
+// значений нет вовсе), NullType — пропуском в битовой карте. Тип столбца берётся из первого значения;
+// буферы тела выровнены на 64 байта от начала потока.
+namespace arrow {
+
+// Минимальный построитель FlatBuffers: буфер растёт от конца к началу, как в официальной библиотеке.
+// Байты хранятся в обратном порядке, смещения объектов считаются от конца буфера.
+class FlatBuilder {
+public:
+    size_t size() const { return reversed_.size(); }
+
+    // Выравнивает так, чтобы после добавления ещё extra байт размер был кратен alignment
+    void align(size_t alignment, size_t extra = 0) {
+        while ((size() + extra) % alignment != 0) {
+            reversed_.push_back(0);
+        }
+    }
+
+    template<typename T>
+    void prepend(T value) {
+        align(sizeof(T));
+        auto bits = static_cast<std::make_unsigned_t<T>>(value);
+        for (size_t i = sizeof(T); i-- > 0;) {
+            reversed_.push_back(static_cast<uint8_t>(static_cast<uint64_t>(bits) >> (8 * i)));
+        }
+    }
+
+    void prependOffset(uint32_t target) {
+        align(sizeof(uint32_t));
+        prepend<uint32_t>(static_cast<uint32_t>(size() + sizeof(uint32_t) - target));
+    }
+
+    uint32_t createString(std::string_view text) {
+        align(sizeof(uint32_t), text.size() + 1);
+        reversed_.push_back(0);
+        for (size_t i = text.size(); i-- > 0;) {
+            reversed_.push_back(static_cast<uint8_t>(text[i]));
+        }
+        prepend<uint32_t>(static_cast<uint32_t>(text.size()));
+        return static_cast<uint32_t>(size());
+    }
+
+    // Вектор структур из двух int64 (FieldNode, Buffer)
+    uint32_t createPairVector(const std::vector<std::array<int64_t, 2>>& pairs) {
+        align(sizeof(uint32_t), pairs.size() * 16);
+        align(sizeof(int64_t), pairs.size() * 16);
+        for (size_t i = pairs.size(); i-- > 0;) {
+            prepend<int64_t>(pairs[i][1]);
+            prepend<int64_t>(pairs[i][0]);
+        }
+        prepend<uint32_t>(static_cast<uint32_t>(pairs.size()));
+        return static_cast<uint32_t>(size());
+    }
+
+    uint32_t createOffsetVector(const std::vector<uint32_t>& targets) {
+        align(sizeof(uint32_t), targets.size() * sizeof(uint32_t));
+        for (size_t i = targets.size(); i-- > 0;) {
+            prependOffset(targets[i]);
+        }
+        prepend<uint32_t>(static_cast<uint32_t>(targets.size()));
+        return static_cast<uint32_t>(size());
+    }
+
+    void startTable() {
+        fields_.clear();
+        tableStart_ = size();
+    }
+
+    template<typename T>
+    void addScalar(uint16_t field, T value) {
+        prepend<T>(value);
+        fields_.push_back({field, static_cast<uint32_t>(size())});
+    }
+
+    void addOffset(uint16_t field, uint32_t target) {
+        prependOffset(target);
+        fields_.push_back({field, static_cast<uint32_t>(size())});
+    }
+
+    // Таблица и её vtable непосредственно перед ней
+    uint32_t endTable() {
+        prepend<int32_t>(0);
+        uint32_t table = static_cast<uint32_t>(size());
+        uint16_t slots = 0;
+        for (const auto& [field, offset] : fields_) {
+            slots = std::max<uint16_t>(slots, field + 1);
+        }
+        std::vector<uint16_t> vtable(2 + slots, 0);
+        vtable[0] = static_cast<uint16_t>(vtable.size() * sizeof(uint16_t));
+        vtable[1] = static_cast<uint16_t>(table - tableStart_);
+        for (const auto& [field, offset] : fields_) {
+            vtable[2 + field] = static_cast<uint16_t>(table - offset);
+        }
+        for (size_t i = vtable.size(); i-- > 0;) {
+            prepend<uint16_t>(vtable[i]);
+        }
+        int32_t toVtable = static_cast<int32_t>(size() - table);
+        for (size_t i = 0; i < sizeof(int32_t); ++i) {
+            reversed_[table - 1 - i] = static_cast<uint8_t>(static_cast<uint32_t>(toVtable) >> (8 * i));
+        }
+        return table;
+    }
+
+    Buffer finish(uint32_t root) {
+        align(8, sizeof(uint32_t));
+        prependOffset(root);
+        Buffer result(reversed_.size());
+        std::transform(reversed_.rbegin(), reversed_.rend(), result.begin(), [](uint8_t b) { return std::byte{b}; });
+        return result;
+    }
+
+private:
+    std::vector<uint8_t> reversed_;
+    std::vector<std::pair<uint16_t, uint32_t>> fields_;
+    size_t tableStart_ = 0;
+};
+
+class StreamWriter {
+public:
+    struct Options {
+        uint64_t rowsPerBatch = 65536;
+        std::vector<std::string> names;  // по умолчанию f0, f1, ...
+    };
+
+    static void fromWire(const Buffer& wire, std::ostream& out) {
+        fromWire(wire, out, Options());
+    }
+
+    static void fromWire(const Buffer& wire, std::ostream& out, const Options& options) {
+        StreamWriter writer(out, options);
+        const std::byte* pos = wire.data();
+        writer.end_ = wire.data() + wire.size();
+        if (WireHeader::present(wire.data(), wire.size())) {
+            WireHeader header = WireHeader::parse(wire.data(), wire.size());
+            pos += WireHeader::kSize;
+            writer.end_ = pos + header.bodyLength;
+        }
+        uint64_t rows = writer.readUint(pos);
+        // Остаток записей нужен для вывода типов столбцов, а у блочной записи он заранее неизвестен
+        if (rows == kChunkedCount) {
+            throw std::runtime_error("Arrow export does not support chunked vectors");
+        }
+        for (uint64_t row = 0; row < rows; ++row) {
+            writer.appendRow(pos);
+            if (writer.batchRows_ == std::max<uint64_t>(options.rowsPerBatch, 1)) {
+                writer.flushBatch(pos, rows - row - 1);
+            }
+        }
+        writer.flushBatch(pos, 0);
+        const uint32_t endOfStream[] = {0xFFFFFFFF, 0};
+        writer.writeInts(endOfStream);
+    }
+
+private:
+    // Столбец текущего пакета; для Utf8 values хранит байты строк, а offsets — их границы
+    struct Column {
+        TypeId type = TypeId::Null;
+        std::vector<uint64_t> validity;
+        uint64_t nullCount = 0;
+        Buffer values;
+        std::vector<int32_t> offsets{0};
+
+        // Очистка между пакетами; тип и выделенная память сохраняются
+        void reset() {
+            validity.clear();
+            nullCount = 0;
+            values.clear();
+            offsets.assign(1, 0);
+        }
+    };
+
+    StreamWriter(std::ostream& out, const Options& options) : out_(out), options_(options) {}
+
+    uint64_t readUint(const std::byte*& pos) const {
+        if (end_ - pos < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t value = fromLittleEndian<uint64_t>(pos);
+        pos += sizeof(uint64_t);
+        return value;
+    }
+
+    uint64_t readFieldCount(const std::byte*& pos) {
+        if (static_cast<TypeId>(readUint(pos)) != TypeId::Vector) {
+            throw std::runtime_error("Arrow export expects every root element to be a Vector record");
+        }
+        uint64_t fields = readUint(pos);
+        if (fields == kChunkedCount) {
+            throw std::runtime_error("Arrow export does not support chunked vectors");
+        }
+        if (columns_.empty() && !schemaWritten_) {
+            columns_.resize(fields);
+        }
+        if (fields != columns_.size()) {
+            throw std::runtime_error("Arrow export expects records with the same number of fields");
+        }
+        return fields;
+    }
+
+    // Пустые места значений до первого известного типа столбца
+    static void fillPlaceholders(Column& column, uint64_t rows) {
+        if (column.type == TypeId::String) {
+            column.offsets.resize(rows + 1, column.offsets.back());
+        } else if (column.type != TypeId::Null) {
+            column.values.resize(rows * sizeof(uint64_t));
+        }
+    }
+
+    void setType(Column& column, TypeId type, uint64_t rowsBefore) {
+        if (column.type == type) {
+            return;
+        }
+        if (column.type != TypeId::Null || schemaWritten_) {
+            throw std::runtime_error("Arrow export expects each field to keep one type");
+        }
+        column.type = type;
+        fillPlaceholders(column, rowsBefore);
+    }
+
+    void appendRow(const std::byte*& pos) {
+        readFieldCount(pos);
+        size_t words = bits::wordCount(batchRows_ + 1);
+        for (Column& column : columns_) {
+            column.validity.resize(words, 0);
+            auto type = static_cast<TypeId>(readUint(pos));
+            if (type == TypeId::Null) {
+                ++column.nullCount;
+                fillPlaceholders(column, batchRows_ + 1);
+                continue;
+            }
+            if (type != TypeId::Uint && type != TypeId::Float && type != TypeId::String) {
+                throw std::runtime_error("Arrow export supports Uint, Float, String and Null fields");
+            }
+            setType(column, type, batchRows_);
+            column.validity[batchRows_ / 64] |= uint64_t{1} << (batchRows_ % 64);
+            if (type == TypeId::String) {
+                uint64_t length = readUint(pos);
+                if (static_cast<uint64_t>(end_ - pos) < length ||
+                    column.values.size() + length > static_cast<uint64_t>(INT32_MAX)) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                transcode::putBytes(column.values, pos, length);
+                column.offsets.push_back(static_cast<int32_t>(column.values.size()));
+                pos += length;
+            } else {
+                if (end_ - pos < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                transcode::putBytes(column.values, pos, sizeof(uint64_t));
+                pos += sizeof(uint64_t);
+            }
+        }
+        ++batchRows_;
+    }
+
+    // Типы столбцов, которые в первом пакете были только пропусками, ищутся в оставшихся записях
+    void inferRemainingTypes(const std::byte* pos, uint64_t rows) {
+        for (uint64_t row = 0; row < rows; ++row) {
+            readFieldCount(pos);
+            bool unknown = false;
+            for (Column& column : columns_) {
+                auto type = static_cast<TypeId>(readUint(pos));
+                if (type == TypeId::String) {
+                    uint64_t length = readUint(pos);
+                    if (static_cast<uint64_t>(end_ - pos) < length) {
+                        throw std::runtime_error("Not enough data for deserialization");
+                    }
+                    pos += length;
+                } else if (type == TypeId::Uint || type == TypeId::Float) {
+                    readUint(pos);
+                } else if (type != TypeId::Null) {
+                    throw std::runtime_error("Arrow export supports Uint, Float, String and Null fields");
+                }
+                if (column.type == TypeId::Null && type != TypeId::Null) {
+                    setType(column, type, batchRows_);
+                }
+                unknown |= column.type == TypeId::Null;
+            }
+            if (!unknown) {
+                return;
+            }
+        }
+    }
+
+    void writeInts(std::span<const uint32_t> values) {
+        for (uint32_t value : values) {
+            auto le = toLittleEndian(value);
+            out_.write(reinterpret_cast<const char*>(le.data()), static_cast<std::streamsize>(le.size()));
+        }
+        position_ += values.size() * sizeof(uint32_t);
+    }
+
+    // Сообщение: продолжение 0xFFFFFFFF, длина метаданных, метаданные (дополнены так, чтобы тело
+    // началось на границе 64 байт), затем тело
+    void writeMessage(const Buffer& metadata, const Buffer& body) {
+        size_t padded = metadata.size();
+        while ((position_ + 8 + padded) % 64 != 0) {
+            padded += 8;
+        }
+        const uint32_t prefix[] = {0xFFFFFFFF, static_cast<uint32_t>(padded)};
+        writeInts(prefix);
+        const Buffer padding(padded - metadata.size());
+        for (const Buffer* part : {&metadata, &padding, &body}) {
+            out_.write(reinterpret_cast<const char*>(part->data()), static_cast<std::streamsize>(part->size()));
+        }
+        position_ += padded + body.size();
+    }
+
+    static uint32_t messageTable(FlatBuilder& builder, uint8_t headerType, uint32_t header, int64_t bodyLength) {
+        builder.startTable();
+        builder.addScalar<int64_t>(3, bodyLength);
+        builder.addOffset(2, header);
+        builder.addScalar<int16_t>(0, 4);  // MetadataVersion V5
+        builder.addScalar<uint8_t>(1, headerType);
+        return builder.endTable();
+    }
+
+    void writeSchema() {
+        FlatBuilder builder;
+        std::vector<uint32_t> fields;
+        for (size_t i = 0; i < columns_.size(); ++i) {
+            TypeId type = columns_[i].type;
+            uint8_t typeType = 1;  // Null
+            builder.startTable();
+            if (type == TypeId::Uint) {
+                typeType = 2;  // Int
+                builder.addScalar<int32_t>(0, 64);
+                builder.addScalar<uint8_t>(1, 0);
+            } else if (type == TypeId::Float) {
+                typeType = 3;  // FloatingPoint
+                builder.addScalar<int16_t>(0, 2);  // DOUBLE
+            } else if (type == TypeId::String) {
+                typeType = 5;  // Utf8
+            }
+            uint32_t typeTable = builder.endTable();
+            uint32_t children = builder.createOffsetVector({});
+            uint32_t name = builder.createString(i < options_.names.size() ? options_.names[i] : "f" + std::to_string(i));
+            builder.startTable();
+            builder.addOffset(0, name);
+            builder.addOffset(3, typeTable);
+            builder.addOffset(5, children);
+            builder.addScalar<uint8_t>(1, 1);  // nullable
+            builder.addScalar<uint8_t>(2, typeType);
+            fields.push_back(builder.endTable());
+        }
+        uint32_t fieldVector = builder.createOffsetVector(fields);
+        builder.startTable();
+        builder.addOffset(1, fieldVector);
+        uint32_t schema = builder.endTable();
+        writeMessage(builder.finish(messageTable(builder, 1, schema, 0)), {});
+        schemaWritten_ = true;
+    }
+
+    void flushBatch(const std::byte* pos, uint64_t rowsLeft) {
+        if (!schemaWritten_) {
+            inferRemainingTypes(pos, rowsLeft);
+            writeSchema();
+        }
+        if (batchRows_ == 0) {
+            return;
+        }
+        Buffer body;
+        std::vector<std::array<int64_t, 2>> nodes;
+        std::vector<std::array<int64_t, 2>> buffers;
+        auto addBuffer = [&](const std::byte* data, size_t size) {
+            buffers.push_back({static_cast<int64_t>(body.size()), static_cast<int64_t>(size)});
+            transcode::putBytes(body, data, size);
+            body.resize((body.size() + 63) & ~size_t{63});
+        };
+        for (Column& column : columns_) {
+            nodes.push_back({static_cast<int64_t>(batchRows_), static_cast<int64_t>(column.nullCount)});
+            if (column.type == TypeId::Null) {
+                continue;
+            }
+            if (column.nullCount == 0) {
+                addBuffer(nullptr, 0);
+            } else {
+                Buffer bitmap;
+                for (uint64_t word : column.validity) {
+                    transcode::putLe64(bitmap, word);
+                }
+                addBuffer(bitmap.data(), (batchRows_ + 7) / 8);
+            }
+            if (column.type == TypeId::String) {
+                Buffer offsets;
+                for (int32_t offset : column.offsets) {
+                    auto le = toLittleEndian(offset);
+                    offsets.insert(offsets.end(), le.begin(), le.end());
+                }
+                addBuffer(offsets.data(), offsets.size());
+            }
+            addBuffer(column.values.data(), column.values.size());
+            column.reset();
+        }
+        FlatBuilder builder;
+        uint32_t bufferVector = builder.createPairVector(buffers);
+        uint32_t nodeVector = builder.createPairVector(nodes);
+        builder.startTable();
+        builder.addScalar<int64_t>(0, static_cast<int64_t>(batchRows_));
+        builder.addOffset(1, nodeVector);
+        builder.addOffset(2, bufferVector);
+        uint32_t batch = builder.endTable();
+        writeMessage(builder.finish(messageTable(builder, 3, batch, static_cast<int64_t>(body.size()))), body);
+        batchRows_ = 0;
+    }
+
+    std::ostream& out_;
+    Options options_;
+    const std::byte* end_ = nullptr;
+    std::vector<Column> columns_;
+    uint64_t batchRows_ = 0;
+    uint64_t position_ = 0;
+    bool schemaWritten_ = false;
+};
+
+} // namespace arrow
+
+// Профиль буфера Serializator за один проход без выделений памяти на элемент: узлы и байты по TypeId,
+// гистограммы длин строк и ширины векторов, распределение глубины, доля повторов и оценка выигрыша
+// альтернативных кодировок. Повторы ищутся по отпечаткам в таблице фиксированного размера,
+// поэтому это нижняя оценка для повторов на большом расстоянии.
+namespace stats {
+
+inline const char* typeName(TypeId type) {
+    switch (type) {
+        case TypeId::Uint: return "Uint";
+        case TypeId::Float: return "Float";
+        case TypeId::String: return "String";
+        case TypeId::Vector: return "Vector";
+        case TypeId::Bool: return "Bool";
+        case TypeId::Bitset: return "Bitset";
+        case TypeId::Tensor: return "Tensor";
+        case TypeId::SparseVector: return "SparseVector";
+        case TypeId::Timestamp: return "Timestamp";
+        case TypeId::TimestampVector: return "TimestampVector";
+        case TypeId::Null: return "Null";
+        case TypeId::NullableVector: return "NullableVector";
+    }
+    return "Unknown";
+}
+
+// Корзина k содержит значения из [2^(k-1), 2^k), корзина 0 — нули
+struct Histogram {
+    std::array<uint64_t, 65> buckets{};
+
+    void add(uint64_t value) { ++buckets[std::bit_width(value)]; }
+
+    void print(std::ostream& out, const char* title) const {
+        out << title << ":\n";
+        for (size_t k = 0; k < buckets.size(); ++k) {
+            if (buckets[k] != 0) {
+                uint64_t low = k == 0 ? 0 : uint64_t{1} << (k - 1);
+                uint64_t high = k == 0 ? 0 : (k == 64 ? UINT64_MAX : (uint64_t{1} << k) - 1);
+                out << "  " << std::setw(20) << (std::to_string(low) + ".." + std::to_string(high)) << "  "
+                    << buckets[k] << '\n';
+            }
+        }
+    }
+};
+
+struct Report {
+    static constexpr size_t kMaxDepth = 256;
+
+    struct TypeTotals {
+        uint64_t count = 0;
+        uint64_t bytes = 0;  // тег и полезная нагрузка; у Vector без детей
+    };
+
+    // Оценка сэкономленных байт при переходе на каждую альтернативу по отдельности
+    struct Savings {
+        uint64_t varintTags = 0;        // теги по 1 байту вместо 8
+        uint64_t varintIntegers = 0;    // Uint в varint
+        uint64_t varintLengths = 0;     // длины строк и векторов в varint
+        uint64_t packedVectors = 0;     // однородные векторы Uint/Float без тегов элементов
+        uint64_t float32 = 0;           // Float, точно представимые в float
+        uint64_t stringDictionary = 0;  // повторные строки как 4-байтовая ссылка
+    };
+
+    uint64_t totalBytes = 0;
+    uint64_t nodes = 0;
+    std::array<TypeTotals, 256> types{};
+    Histogram stringLengths;
+    Histogram vectorWidths;
+    std::array<uint64_t, kMaxDepth> depths{};
+    uint64_t hashedValues = 0;
+    uint64_t repeatedValues = 0;
+    Savings savings;
+
+    void print(std::ostream& out, double seconds) const {
+        out << "Bytes: " << totalBytes << ", nodes: " << nodes;
+        if (seconds > 0) {
+            out << ", scanned at " << std::fixed << std::setprecision(2) << totalBytes / seconds / 1e9 << " GB/s";
+            out.unsetf(std::ios_base::floatfield);
+        }
+        out << "\nBy type:\n";
+        for (size_t id = 0; id < types.size(); ++id) {
+            if (types[id].count != 0) {
+                out << "  " << std::left << std::setw(16) << typeName(static_cast<TypeId>(id)) << std::right
+                    << std::setw(14) << types[id].count << " nodes " << std::setw(16) << types[id].bytes << " bytes\n";
+            }
+        }
+        stringLengths.print(out, "String lengths");
+        vectorWidths.print(out, "Vector widths");
+        out << "Depth:\n";
+        for (size_t depth = 0; depth < depths.size(); ++depth) {
+            if (depths[depth] != 0) {
+                out << "  " << std::setw(4) << depth << "  " << depths[depth] << '\n';
+            }
+        }
+        out << "Repetition: " << repeatedValues << " of " << hashedValues << " scalar and string values";
+        if (hashedValues != 0) {
+            out << " (" << std::fixed << std::setprecision(1) << 100.0 * repeatedValues / hashedValues << "%)";
+            out.unsetf(std::ios_base::floatfield);
+        }
+        out << "\nEstimated savings:\n";
+        const std::pair<const char*, uint64_t> rows[] = {
+            {"varint tags", savings.varintTags},         {"varint integers", savings.varintIntegers},
+            {"varint lengths", savings.varintLengths},   {"packed numeric vectors", savings.packedVectors},
+            {"float32 narrowing", savings.float32},      {"string dictionary", savings.stringDictionary},
+        };
+        for (const auto& [name, bytes] : rows) {
+            out << "  " << std::left << std::setw(24) << name << std::right << std::setw(16) << bytes << " bytes";
+            if (totalBytes != 0) {
+                out << " (" << std::fixed << std::setprecision(1) << 100.0 * bytes / totalBytes << "%)";
+                out.unsetf(std::ios_base::floatfield);
+            }
+            out << '\n';
+        }
+    }
+};
+
+class Scanner {
+public:
+    static constexpr size_t kSeenSlots = 1 << 16;
+
+    Scanner() : seen_(kSeenSlots, 0) {}
+
+    // Обход без рекурсии: стек векторов фиксированной глубины
+    const Report& scan(const std::byte* data, size_t size) {
+        report_ = Report();
+        pos_ = data;
+        end_ = data + size;
+        if (WireHeader::present(data, size)) {
+            WireHeader header = WireHeader::parse(data, size);
+            pos_ += WireHeader::kSize;
+            end_ = pos_ + header.bodyLength;
+        }
+        report_.totalBytes = static_cast<uint64_t>(end_ - pos_);
+        size_t depth = 0;
+        uint64_t roots = readUint();
+        frames_[0] = openFrame(roots);
+        if (roots != kChunkedCount) {
+            report_.savings.varintLengths += 8 - varintSize(roots);
+        }
+        while (true) {
+            Frame& frame = frames_[depth];
+            if (frame.remaining == 0 && frame.chunked) {
+                // Заголовок следующего блока; нулевой завершает вектор, и тогда известна его ширина
+                uint64_t chunk = readUint();
+                if (chunk == kChunkedCount) {
+                    throw std::runtime_error("Malformed chunked vector");
+                }
+                if (chunk > static_cast<uint64_t>(end_ - pos_) / sizeof(uint64_t)) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                frame.remaining = chunk;
+                if (chunk == 0) {
+                    frame.chunked = false;
+                    if (depth != 0) {
+                        report_.vectorWidths.add(frame.width);
+                    }
+                }
+                continue;
+            }
+            if (frame.remaining == 0) {
+                if (frame.homogeneous && frame.width > 1 && (frame.type == TypeId::Uint || frame.type == TypeId::Float)) {
+                    report_.savings.packedVectors += (frame.width - 1) * sizeof(uint64_t);
+                }
+                if (depth == 0) {
+                    break;
+                }
+                --depth;
+                continue;
+            }
+            --frame.remaining;
+            TypeId type = visit(depth);
+            if (frame.width++ == 0) {
+                frame.type = type;
+            }
+            frame.homogeneous &= frame.type == type;
+            if (type == TypeId::Vector) {
+                if (++depth == Report::kMaxDepth) {
+                    throw std::runtime_error("Nesting too deep for stats");
+                }
+                frames_[depth] = openFrame(pendingWidth_);
+            }
+        }
+        return report_;
+    }
+
+private:
+    struct Frame {
+        uint64_t remaining;
+        uint64_t width;
+        TypeId type;
+        bool homogeneous;
+        bool chunked = false;  // remaining — остаток текущего блока
+    };
+
+    static Frame openFrame(uint64_t count) {
+        bool chunked = count == kChunkedCount;
+        return Frame{chunked ? 0 : count, 0, TypeId::Null, true, chunked};
+    }
+
+    static uint64_t varintSize(uint64_t value) {
+        return std::max<uint64_t>(1, (std::bit_width(value) + 6) / 7);
+    }
+
+    uint64_t readUint() {
+        if (end_ - pos_ < static_cast<std::ptrdiff_t>(sizeof(uint64_t))) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        uint64_t value = fromLittleEndian<uint64_t>(pos_);
+        pos_ += sizeof(uint64_t);
+        return value;
+    }
+
+    void skip(uint64_t bytes) {
+        if (static_cast<uint64_t>(end_ - pos_) < bytes) {
+            throw std::runtime_error("Not enough data for deserialization");
+        }
+        pos_ += bytes;
+    }
+
+    // Отмечает значение в таблице отпечатков; true, если оно уже встречалось
+    bool repeated(uint64_t fingerprint) {
+        ++report_.hashedValues;
+        uint64_t& slot = seen_[(fingerprint * 0x9E3779B97F4A7C15ULL) >> (64 - std::countr_zero(kSeenSlots))];
+        if (slot == fingerprint) {
+            ++report_.repeatedValues;
+            return true;
+        }
+        slot = fingerprint;
+        return false;
+    }
+
+    // Размер полезной нагрузки расширенных типов по их заголовкам, без декодирования
+    uint64_t extendedPayloadSize(TypeId type) const {
+        size_t available = static_cast<size_t>(end_ - pos_);
+        auto field = [&](size_t offset) {
+            if (available < offset + sizeof(uint64_t)) {
+                throw std::runtime_error("Not enough data for deserialization");
+            }
+            return fromLittleEndian<uint64_t>(pos_ + offset);
+        };
+        switch (type) {
+            case TypeId::Bool: return 1;
+            case TypeId::Timestamp: return sizeof(int64_t);
+            case TypeId::Null: return 0;
+            case TypeId::Bitset:
+                return sizeof(uint64_t) + bits::View::fromPayload(pos_, available).wordCount() * 8;
+            case TypeId::Tensor: {
+                uint64_t rank = field(8);
+                if (rank > TensorLayout::kMaxRank) {
+                    throw std::runtime_error("Tensor rank too large");
+                }
+                size_t header = (4 + 2 * static_cast<size_t>(rank)) * sizeof(uint64_t);
+                return header + field(header - 8) + field(header - 16);
+            }
+            case TypeId::SparseVector: return sparse::View::fromPayload(pos_, available).payloadSize();
+            case TypeId::TimestampVector: return 3 * sizeof(uint64_t) + field(16);
+            case TypeId::NullableVector: return nullable::View::fromPayload(pos_, available).payloadSize();
+            default:
+                throw std::runtime_error("Unknown type");
+        }
+    }
+
+    TypeId visit(size_t depth) {
+        auto type = static_cast<TypeId>(readUint());
+        uint64_t payload = sizeof(uint64_t);
+        ++report_.nodes;
+        ++report_.depths[depth];
+        report_.savings.varintTags += sizeof(uint64_t) - 1;
+        switch (type) {
+            case TypeId::Uint: {
+                uint64_t value = readUint();
+                report_.savings.varintIntegers += 8 - varintSize(value);
+                repeated(value ^ 0x5555555555555555ULL);
+                break;
+            }
+            case TypeId::Float: {
+                uint64_t raw = readUint();
+                double value;
+                std::memcpy(&value, &raw, sizeof(value));
+                if (static_cast<double>(static_cast<float>(value)) == value) {
+                    report_.savings.float32 += sizeof(double) - sizeof(float);
+                }
+                repeated(raw ^ 0xAAAAAAAAAAAAAAAAULL);
+                break;
+            }
+            case TypeId::String: {
+                uint64_t length = readUint();
+                const std::byte* text = pos_;
+                skip(length);
+                payload += length;
+                report_.stringLengths.add(length);
+                report_.savings.varintLengths += 8 - varintSize(length);
+                uint64_t fingerprint = std::hash<std::string_view>()(
+                    std::string_view(reinterpret_cast<const char*>(text), static_cast<size_t>(length)));
+                if (repeated(fingerprint ^ length) && length + sizeof(uint64_t) > 4) {
+                    report_.savings.stringDictionary += length + sizeof(uint64_t) - 4;
+                }
+                break;
+            }
+            case TypeId::Vector:
+                pendingWidth_ = readUint();
+                if (pendingWidth_ == kChunkedCount) {
+                    break;  // ширина учитывается после последнего блока
+                }
+                if (pendingWidth_ > static_cast<uint64_t>(end_ - pos_) / sizeof(uint64_t)) {
+                    throw std::runtime_error("Not enough data for deserialization");
+                }
+                report_.vectorWidths.add(pendingWidth_);
+                report_.savings.varintLengths += 8 - varintSize(pendingWidth_);
+                break;
+            default: {
+                uint64_t size = extendedPayloadSize(type);
+                skip(size);
+                payload = size;
+                break;
+            }
+        }
+        Report::TypeTotals& totals = report_.types[static_cast<uint8_t>(type)];
+        ++totals.count;
+        totals.bytes += sizeof(uint64_t) + payload;
+        return type;
+    }
+
+    std::vector<uint64_t> seen_;
+    std::array<Frame, Report::kMaxDepth> frames_{};
+    Report report_;
+    const std::byte* pos_ = nullptr;
+    const std::byte* end_ = nullptr;
+    uint64_t pendingWidth_ = 0;
+};
+
+} // namespace stats
+
+// Файл, отображённый в память только для чтения; без POSIX читается в буфер целиком
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        struct stat st{};
+        if (fstat(fd, &st) != 0) {
+            close(fd);
+            throw std::runtime_error("Failed to stat " + path);
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0) {
+            void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Failed to map " + path);
+            }
+            data_ = static_cast<const std::byte*>(mapped);
+        }
+        close(fd);
+#else
+        std::ifstream raw(path, std::ios_base::in | std::ios_base::binary);
+        if (!raw.is_open()) {
+            throw std::runtime_error("Failed to open " + path);
+        }
+        fallback_.assign(std::istreambuf_iterator<char>(raw), {});
+        data_ = reinterpret_cast<const std::byte*>(fallback_.data());
+        size_ = fallback_.size();
+#endif
+    }
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data_) {
+            munmap(const_cast<std::byte*>(data_), size_);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::byte* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const std::byte* data_ = nullptr;
+    size_t size_ = 0;
+#if !defined(__unix__) && !defined(__APPLE__)
+    std::string fallback_;
+#endif
+};
+
+// Аппаратные счётчики производительности процесса (Linux perf_event).
+// Недоступные события (нет прав, виртуализация, другая ОС) просто не отображаются.
+class PerfCounters {
+public:
+    enum Event { Cycles, Instructions, BranchMisses, L1dMisses, LlcMisses, DtlbMisses, kEventCount };
+
+    using Values = std::array<std::optional<double>, kEventCount>;
+
+    PerfCounters() {
+        fds_.fill(-1);
+#ifdef __linux__
+        constexpr uint64_t kReadMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        const std::array<std::pair<uint32_t, uint64_t>, kEventCount> events = {{
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | kReadMiss},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | kReadMiss},
+            {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | kReadMiss},
+        }};
+        for (size_t i = 0; i < kEventCount; ++i) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.type = events[i].first;
+            attr.config = events[i].second;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool available() const {
+        return std::any_of(fds_.begin(), fds_.end(), [](int fd) { return fd >= 0; });
+    }
+
+    void start() {
+#ifdef __linux__
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+#endif
+    }
+
+    void stop() {
+#ifdef __linux__
+        for (int fd : fds_) {
+            if (fd >= 0) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+#endif
+    }
+
+    // Значения с поправкой на мультиплексирование счётчиков ядром
+    Values read() const {
+        Values values;
+#ifdef __linux__
+        for (size_t i = 0; i < kEventCount; ++i) {
+            uint64_t data[3] = {};
+            if (fds_[i] < 0 || ::read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+                continue;
+            }
+            values[i] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+        }
+#endif
+        return values;
+    }
+
+    static const char* eventName(Event event) {
+        static const char* names[kEventCount] = {
+            "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "dTLB-misses"};
+        return names[event];
+    }
+
+private:
+    std::array<int, kEventCount> fds_;
+};
+
+// Не даёт компилятору выбросить результат измеряемого кода
+inline volatile size_t benchmarkSink = 0;
+
+inline void doNotOptimize(size_t value) {
+    benchmarkSink = value;
+}
+
+struct BenchmarkResult {
+    std::string name;
+    uint64_t elements = 0;
+    uint64_t bytes = 0;
+    uint64_t iterations = 0;
+    std::vector<double> samplesNs;  // время одной итерации в каждом замере
+    PerfCounters::Values counters;  // на одну итерацию
+    std::optional<AllocationTracker::Stats> allocations;  // на одну итерацию
+};
+
+// Простой стенд: каждый случай прогоняется заданное число замеров,
+// число итераций в замере подбирается так, чтобы замер длился не меньше minSampleTime
+class BenchmarkHarness {
+public:
+    void addCase(std::string name, uint64_t elements, uint64_t bytes, std::function<void()> body) {
+        cases_.push_back({std::move(name), elements, bytes, std::move(body)});
+    }
+
+    std::vector<BenchmarkResult> run(size_t samples,
+                                     std::chrono::nanoseconds minSampleTime = std::chrono::milliseconds(50)) const {
+        std::vector<BenchmarkResult> results;
+        PerfCounters counters;
+        for (const auto& c : cases_) {
+            BenchmarkResult result;
+            result.name = c.name;
+            result.elements = c.elements;
+            result.bytes = c.bytes;
+
+            uint64_t iterations = 1;
+            while (true) {
+                auto start = std::chrono::steady_clock::now();
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    c.body();
+                }
+                if (std::chrono::steady_clock::now() - start >= minSampleTime || iterations >= (uint64_t{1} << 30)) {
+                    break;
+                }
+                iterations *= 2;
+            }
+
+            AllocationTracker::Scope allocationScope;
+            counters.start();
+            for (size_t s = 0; s < samples; ++s) {
+                auto start = std::chrono::steady_clock::now();
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    c.body();
+                }
+                auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+                result.samplesNs.push_back(elapsed.count() / static_cast<double>(iterations));
+            }
+            counters.stop();
+
+            result.iterations = iterations * samples;
+            if (AllocationTracker::enabled() && result.iterations) {
+                AllocationTracker::Stats total = allocationScope.delta();
+                result.allocations = AllocationTracker::Stats{total.allocations / result.iterations,
+                                                              total.bytes / result.iterations};
+            }
+            result.counters = counters.read();
+            for (auto& value : result.counters) {
+                if (value) {
+                    *value /= static_cast<double>(result.iterations);
+                }
+            }
+            results.push_back(std::move(result));
+        }
+        return results;
+    }
+
+    static void report(const std::vector<BenchmarkResult>& results, std::ostream& out) {
+        for (const auto& r : results) {
+            std::vector<double> sorted = r.samplesNs;
+            std::sort(sorted.begin(), sorted.end());
+            double median = sorted.empty() ? 0.0 : sorted[sorted.size() / 2];
+            double perElement = r.elements ? median / static_cast<double>(r.elements) : 0.0;
+            double mbPerSec = median > 0.0 ? static_cast<double>(r.bytes) / median * 1e3 : 0.0;
+
+            out << r.name << ": " << median << " ns/op, " << perElement << " ns/element, "
+                << mbPerSec << " MB/s (" << r.iterations << " iterations)\n";
+
+            const auto& cycles = r.counters[PerfCounters::Cycles];
+            const auto& instructions = r.counters[PerfCounters::Instructions];
+            if (r.allocations) {
+                out << "    allocations: " << r.allocations->allocations << "/op, "
+                    << r.allocations->bytes << " bytes/op\n";
+            }
+            if (cycles && instructions && *cycles > 0.0) {
+                out << "    IPC: " << *instructions / *cycles << '\n';
+            }
+            for (size_t e = 0; e < PerfCounters::kEventCount; ++e) {
+                const auto& value = r.counters[e];
+                out << "    " << PerfCounters::eventName(static_cast<PerfCounters::Event>(e)) << ": ";
+                if (!value) {
+                    out << "n/a\n";
+                    continue;
+                }
+                out << *value << "/op";
+                if (r.elements) {
+                    out << ", " << *value / static_cast<double>(r.elements) << "/element";
+                }
+                out << '\n';
+            }
+        }
+    }
+
+private:
+    struct Case {
+        std::string name;
+        uint64_t elements;
+        uint64_t bytes;
+        std::function<void()> body;
+    };
+
+    std::vector<Case> cases_;
+};
+
+// Чтение файла целиком в буфер
+inline Buffer readFile(const std::string& path) {
+    std::ifstream raw(path, std::ios_base::in | std::ios_base::binary);
+    if (!raw.is_open()) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    raw.seekg(0, std::ios_base::end);
+    std::streamsize size = raw.tellg();
+    raw.seekg(0, std::ios_base::beg);
+
+    Buffer buff(size);
+    raw.read(reinterpret_cast<char*>(buff.data()), size);
+    return buff;
+}
+
+// Набор случаев для кодека на содержимом одного файла
+inline BenchmarkHarness makeCodecBenchmarks(const Buffer& input) {
+    auto decoded = Serializator::deserialize(input);
+    auto encoder = std::make_shared<Serializator>();
+    for (auto&& i : decoded)
+        encoder->push(i);
+    uint64_t elements = countElements(decoded);
+
+    BenchmarkHarness harness;
+    harness.addCase("Serializator::deserialize", elements, input.size(), [&input] {
+        doNotOptimize(Serializator::deserialize(input).size());
+    });
+    auto cache = std::make_shared<DecodeCache>(size_t{1} << 30);
+    cache->decode(input);
+    harness.addCase("DecodeCache::decode (hit)", elements, input.size(), [&input, cache] {
+        doNotOptimize(cache->decode(input)->size());
+    });
+    harness.addCase("Serializator::serialize", elements, input.size(), [encoder] {
+        doNotOptimize(encoder->serialize().size());
+    });
+    return harness;
+}
+
+// Аргументы командной строки: позиционные и опции вида --key=value
+struct CommandLine {
+    std::vector<std::string> positional;
+    std::map<std::string, std::string> options;
+
+    CommandLine(int argc, char* argv[]) {
+        for (int i = 0; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.rfind("--", 0) == 0) {
+                auto eq = arg.find('=');
+                options[arg.substr(2, eq == std::string::npos ? std::string::npos : eq - 2)] =
+                    eq == std::string::npos ? "" : arg.substr(eq + 1);
+            } else {
+                positional.push_back(arg);
+            }
+        }
+    }
+
+    std::string get(size_t index, const std::string& fallback) const {
+        return index < positional.size() ? positional[index] : fallback;
+    }
+
+    std::string option(const std::string& key, const std::string& fallback) const {
+        auto it = options.find(key);
+        return it != options.end() ? it->second : fallback;
+    }
+};
+
+// Файл результатов: по строке на случай — имя, выделения и байты на итерацию ("-" если не считались),
+// затем все замеры в нс на итерацию
+inline void saveBenchmarkResults(const std::vector<BenchmarkResult>& results, const std::string& path) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    out << std::setprecision(17);
+    for (const auto& r : results) {
+        out << r.name << '\t';
+        if (r.allocations) {
+            out << r.allocations->allocations << '\t' << r.allocations->bytes;
+        } else {
+            out << "-\t-";
+        }
+        for (double sample : r.samplesNs) {
+            out << '\t' << sample;
+        }
+        out << '\n';
+    }
+}
+
+// Целое без знака целиком, без хвостов и минусов, которые пропускает std::stoull
+inline uint64_t parseUnsigned(const std::string& text, const std::string& what) {
+    uint64_t value = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc() || end != text.data() + text.size() || text.empty()) {
+        throw std::runtime_error("Invalid " + what + ": '" + text + "'");
+    }
+    return value;
+}
+
+inline std::vector<BenchmarkResult> loadBenchmarkResults(const std::string& path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open " + path);
+    }
+    std::vector<BenchmarkResult> results;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        std::istringstream fields(line);
+        BenchmarkResult r;
+        std::string allocations, bytes;
+        if (!std::getline(fields, r.name, '\t') || !(fields >> allocations >> bytes)) {
+            throw std::runtime_error("Malformed benchmark results line: " + line);
+        }
+        if (allocations != "-") {
+            r.allocations = AllocationTracker::Stats{parseUnsigned(allocations, "allocation count in " + path),
+                                                     parseUnsigned(bytes, "allocated bytes in " + path)};
+        }
+        for (double sample; fields >> sample;) {
+            r.samplesNs.push_back(sample);
+        }
+        results.push_back(std::move(r));
+    }
+    return results;
+}
+
+// U-критерий Манна-Уитни (нормальное приближение с поправкой на связки):
+// p-value гипотезы "замеры candidate систематически больше baseline"
+inline double mannWhitneyGreaterPValue(const std::vector<double>& baseline, const std::vector<double>& candidate) {
+    size_t n1 = baseline.size();
+    size_t n2 = candidate.size();
+    if (n1 == 0 || n2 == 0) {
+        return 1.0;
+    }
+    std::vector<std::pair<double, bool>> all;
+    for (double v : baseline) all.emplace_back(v, false);
+    for (double v : candidate) all.emplace_back(v, true);
+    std::sort(all.begin(), all.end());
+
+    size_t n = all.size();
+    double candidateRankSum = 0.0;
+    double tieTerm = 0.0;
+    for (size_t i = 0; i < n;) {
+        size_t j = i;
+        while (j < n && all[j].first == all[i].first) {
+            ++j;
+        }
+        double rank = (static_cast<double>(i + j) + 1.0) / 2.0;
+        for (size_t k = i; k < j; ++k) {
+            if (all[k].second) {
+                candidateRankSum += rank;
+            }
+        }
+        double t = static_cast<double>(j - i);
+        tieTerm += t * t * t - t;
+        i = j;
+    }
+
+    double u = candidateRankSum - static_cast<double>(n2) * (n2 + 1) / 2.0;
+    double mean = static_cast<double>(n1) * n2 / 2.0;
+    double variance = static_cast<double>(n1) * n2 / 12.0 *
+                      ((n + 1) - tieTerm / (static_cast<double>(n) * (n - 1)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    double z = (u - mean - 0.5) / std::sqrt(variance);
+    return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+struct RegressionThresholds {
+    double maxSlowdownPercent = 5.0;        // допустимый рост медианы времени
+    double alpha = 0.01;                    // уровень значимости теста
+    double maxAllocationGrowthPercent = 0.0;
+};
+
+// Сравнивает прогоны по случаям с одинаковыми именами; true, если есть значимая регрессия
+inline bool reportRegressions(const std::vector<BenchmarkResult>& baseline, const std::vector<BenchmarkResult>& current,
+                              const RegressionThresholds& thresholds, std::ostream& out) {
+    auto median = [](std::vector<double> v) {
+        std::sort(v.begin(), v.end());
+        return v.empty() ? 0.0 : v[v.size() / 2];
+    };
+    auto growth = [](double before, double after) {
+        return before > 0.0 ? (after - before) / before * 100.0 : 0.0;
+    };
+
+    bool regressed = false;
+    for (const auto& cur : current) {
+        auto base = std::find_if(baseline.begin(), baseline.end(),
+                                 [&](const BenchmarkResult& r) { return r.name == cur.name; });
+        if (base == baseline.end()) {
+            out << cur.name << ": no baseline\n";
+            continue;
+        }
+
+        double slowdown = growth(median(base->samplesNs), median(cur.samplesNs));
+        double pValue = mannWhitneyGreaterPValue(base->samplesNs, cur.samplesNs);
+        bool slower = slowdown > thresholds.maxSlowdownPercent && pValue < thresholds.alpha;
+        out << cur.name << ": time " << std::showpos << slowdown << std::noshowpos << "% (p=" << pValue << ")"
+            << (slower ? " REGRESSION" : "") << '\n';
+        regressed |= slower;
+
+        if (base->allocations && cur.allocations) {
+            double allocGrowth = growth(static_cast<double>(base->allocations->allocations),
+                                        static_cast<double>(cur.allocations->allocations));
+            double bytesGrowth = growth(static_cast<double>(base->allocations->bytes),
+                                        static_cast<double>(cur.allocations->bytes));
+            bool moreAllocations = allocGrowth > thresholds.maxAllocationGrowthPercent ||
+                                   bytesGrowth > thresholds.maxAllocationGrowthPercent;
+            out << cur.name << ": allocations " << std::showpos << allocGrowth << "%, bytes " << bytesGrowth
+                << std::noshowpos << "%" << (moreAllocations ? " REGRESSION" : "") << '\n';
+            regressed |= moreAllocations;
+        }
+    }
+    return regressed;
+}
+
+// Режим bench: main bench [файл] [число замеров] [--save=результаты]
+inline int runBenchmark(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    std::string path = args.get(0, "raw.bin");
+    try {
+        size_t samples = parseUnsigned(args.get(1, "10"), "sample count");
+        Buffer input = readFile(path);
+        BenchmarkHarness harness = makeCodecBenchmarks(input);
+        if (!PerfCounters().available()) {
+            std::cerr << "Hardware counters unavailable, reporting timings only\n";
+        }
+        auto results = harness.run(samples);
+        BenchmarkHarness::report(results, std::cout);
+        std::string savePath = args.option("save", "");
+        if (!savePath.empty()) {
+            saveBenchmarkResults(results, savePath);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Режим bench-compare: main bench-compare <базовые результаты> [файл] [число замеров]
+//     [--threshold=%] [--alpha=p] [--alloc-threshold=%]
+// Код возврата 2 при значимой регрессии
+inline int runBenchmarkCompare(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.empty()) {
+        std::cerr << "Usage: bench-compare <baseline> [file] [samples]\n";
+        return 1;
+    }
+    RegressionThresholds thresholds;
+    try {
+        thresholds.maxSlowdownPercent = std::stod(args.option("threshold", "5"));
+        thresholds.alpha = std::stod(args.option("alpha", "0.01"));
+        thresholds.maxAllocationGrowthPercent = std::stod(args.option("alloc-threshold", "0"));
+
+        auto baseline = loadBenchmarkResults(args.get(0, ""));
+        Buffer input = readFile(args.get(1, "raw.bin"));
+        auto current = makeCodecBenchmarks(input).run(parseUnsigned(args.get(2, "20"), "sample count"));
+        return reportRegressions(baseline, current, thresholds, std::cout) ? 2 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+}
+
+// Описание распределения синтетических данных
+struct PayloadSpec {
+    std::array<double, 4> typeWeights = {4.0, 2.0, 2.0, 1.0};  // Uint, Float, String, Vector
+    double stringLengthMean = 16.0;    // длины строк распределены экспоненциально
+    uint64_t stringLengthMax = 256;
+    double vectorWidthMean = 8.0;      // ширины векторов распределены экспоненциально
+    uint64_t vectorWidthMax = 64;
+    unsigned maxDepth = 3;             // глубже векторы не порождаются
+    double repetitionRate = 0.1;       // доля элементов верхнего уровня, повторяющих недавние
+
+    // Формат: "uint=4,float=2,string=2,vector=1,strlen=16,strmax=256,width=8,widthmax=64,depth=3,repeat=0.1"
+    static PayloadSpec parse(const std::string& text) {
+        PayloadSpec spec;
+        std::istringstream items(text);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            auto eq = item.find('=');
+            if (eq == std::string::npos) {
+                throw std::runtime_error("Malformed payload spec item: " + item);
+            }
+            std::string key = item.substr(0, eq);
+            double value = std::stod(item.substr(eq + 1));
+            if (key == "uint") spec.typeWeights[0] = value;
+            else if (key == "float") spec.typeWeights[1] = value;
+            else if (key == "string") spec.typeWeights[2] = value;
+            else if (key == "vector") spec.typeWeights[3] = value;
+            else if (key == "strlen") spec.stringLengthMean = value;
+            else if (key == "strmax") spec.stringLengthMax = static_cast<uint64_t>(value);
+            else if (key == "width") spec.vectorWidthMean = value;
+            else if (key == "widthmax") spec.vectorWidthMax = static_cast<uint64_t>(value);
+            else if (key == "depth") spec.maxDepth = static_cast<unsigned>(value);
+            else if (key == "repeat") spec.repetitionRate = value;
+            else throw std::runtime_error("Unknown payload spec key: " + key);
+        }
+        return spec;
+    }
+};
+
+// Детерминированный генератор буферов формата Serializator. Пишет байты напрямую,
+// без построения Any, и сбрасывает их в поток блоками, так что размер вывода не ограничен памятью.
+class PayloadGenerator {
+public:
+    PayloadGenerator(const PayloadSpec& spec, uint64_t seed) : spec_(spec) {
+        for (auto& word : rng_) {
+            word = splitMix(seed);
+        }
+        double total = 0.0;
+        for (double w : spec_.typeWeights) {
+            total += w;
+        }
+        if (total <= 0.0) {
+            throw std::runtime_error("Payload spec has no types");
+        }
+        double acc = 0.0;
+        for (size_t i = 0; i < thresholds_.size(); ++i) {
+            acc += spec_.typeWeights[i] / total;
+            thresholds_[i] = acc >= 1.0 ? UINT64_MAX : static_cast<uint64_t>(acc * 0x1p64);
+        }
+        thresholds_.back() = UINT64_MAX;
+        repeatThreshold_ = spec_.repetitionRate >= 1.0 ? UINT64_MAX
+                                                       : static_cast<uint64_t>(spec_.repetitionRate * 0x1p64);
+        textPool_.resize(kTextPoolSize + spec_.stringLengthMax);
+        for (auto& c : textPool_) {
+            c = static_cast<std::byte>('a' + next() % 26);
+        }
+    }
+
+    // Дописывает в out один элемент верхнего уровня (тег и значение)
+    void generateElement(Buffer& out) {
+        used_ = 0;
+        recent_.clear();
+        writeElement();
+        out.insert(out.end(), chunk_.begin(), chunk_.begin() + used_);
+    }
+
+    // Пишет заголовок и ровно elements элементов; возвращает число записанных байт
+    uint64_t generate(std::ostream& out, uint64_t elements) {
+        used_ = 0;
+        recent_.clear();
+        putUint(elements);
+        uint64_t written = 0;
+        for (uint64_t i = 0; i < elements; ++i) {
+            writeElement();
+            if (used_ >= kChunkSize) {
+                written += flush(out);
+            }
+        }
+        return written + flush(out);
+    }
+
+    // Пишет элементы, пока вывод не достигнет targetBytes; число элементов дописывается
+    // в заголовок в конце, поэтому поток должен поддерживать позиционирование
+    uint64_t generateBytes(std::ostream& out, uint64_t targetBytes, uint64_t& elements) {
+        std::streampos headerPos = out.tellp();
+        used_ = 0;
+        recent_.clear();
+        putUint(0);
+        uint64_t written = 0;
+        elements = 0;
+        while (written + used_ < targetBytes) {
+            writeElement();
+            ++elements;
+            if (used_ >= kChunkSize) {
+                written += flush(out);
+            }
+        }
+        written += flush(out);
+        std::streampos endPos = out.tellp();
+        out.seekp(headerPos);
+        auto countLe = toLittleEndian(elements);
+        out.write(reinterpret_cast<const char*>(countLe.data()), static_cast<std::streamsize>(countLe.size()));
+        out.seekp(endPos);
+        if (!out) {
+            throw std::runtime_error("Failed to back-patch element count");
+        }
+        return written;
+    }
+
+private:
+    static constexpr size_t kChunkSize = size_t{1} << 20;
+    static constexpr size_t kTextPoolSize = size_t{1} << 16;
+    static constexpr size_t kRecentCount = 16;
+
+    static uint64_t splitMix(uint64_t& state) {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+    // xoshiro256**
+    uint64_t next() {
+        uint64_t result = rotl(rng_[1] * 5, 7) * 9;
+        uint64_t t = rng_[1] << 17;
+        rng_[2] ^= rng_[0];
+        rng_[3] ^= rng_[1];
+        rng_[1] ^= rng_[2];
+        rng_[0] ^= rng_[3];
+        rng_[2] ^= t;
+        rng_[3] = rotl(rng_[3], 45);
+        return result;
+    }
+
+    double uniform() { return static_cast<double>(next() >> 11) * 0x1p-53; }
+
+    uint64_t exponential(double mean, uint64_t max) {
+        double value = -std::log1p(-uniform()) * mean;
+        return std::min<uint64_t>(static_cast<uint64_t>(value), max);
+    }
+
+    // Место под count байт в текущем блоке; блок растёт, если элемент в него не помещается
+    std::byte* reserveBytes(size_t count) {
+        if (used_ + count > chunk_.size()) {
+            chunk_.resize(std::max(chunk_.size() * 2, used_ + count));
+        }
+        std::byte* ptr = chunk_.data() + used_;
+        used_ += count;
+        return ptr;
+    }
+
+    void putUint(uint64_t value) {
+        std::byte* ptr = reserveBytes(sizeof(uint64_t));
+        for (size_t i = 0; i < sizeof(uint64_t); ++i) {
+            ptr[i] = static_cast<std::byte>(value & 0xFF);
+            value >>= 8;
+        }
+    }
+
+    void writeElement() {
+        if (!recent_.empty() && next() < repeatThreshold_) {
+            auto [offset, length] = recent_[next() % recent_.size()];
+            std::byte* ptr = reserveBytes(length);
+            std::memcpy(ptr, chunk_.data() + offset, length);
+            return;
+        }
+        size_t start = used_;
+        writeAny(0);
+        if (recent_.size() < kRecentCount) {
+            recent_.emplace_back(start, used_ - start);
+        } else {
+            recent_[recentPos_++ % kRecentCount] = {start, used_ - start};
+        }
+    }
+
+    void writeAny(unsigned depth) {
+        uint64_t pick = next();
+        size_t type = 0;
+        while (pick > thresholds_[type]) {
+            ++type;
+        }
+        if (type == static_cast<size_t>(TypeId::Vector) && depth >= spec_.maxDepth) {
+            type = static_cast<size_t>(TypeId::Uint);
+        }
+        putUint(type);
+        switch (static_cast<TypeId>(type)) {
+            case TypeId::Uint:
+                putUint(pick >> (pick & 63));
+                break;
+            case TypeId::Float: {
+                double value = uniform() * 1e6;
+                uint64_t raw;
+                std::memcpy(&raw, &value, sizeof(raw));
+                putUint(raw);
+                break;
+            }
+            case TypeId::String: {
+                uint64_t length = exponential(spec_.stringLengthMean, spec_.stringLengthMax);
+                putUint(length);
+                std::memcpy(reserveBytes(length), textPool_.data() + pick % kTextPoolSize, length);
+                break;
+            }
+            case TypeId::Vector: {
+                uint64_t width = exponential(spec_.vectorWidthMean, spec_.vectorWidthMax);
+                putUint(width);
+                for (uint64_t i = 0; i < width; ++i) {
+                    writeAny(depth + 1);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+
+    uint64_t flush(std::ostream& out) {
+        out.write(reinterpret_cast<const char*>(chunk_.data()), static_cast<std::streamsize>(used_));
+        if (!out) {
+            throw std::runtime_error("Failed to write generated payload");
+        }
+        uint64_t written = used_;
+        used_ = 0;
+        recent_.clear();
+        return written;
+    }
+
+    PayloadSpec spec_;
+    std::array<uint64_t, 4> rng_{};
+    std::array<uint64_t, 4> thresholds_{};
+    uint64_t repeatThreshold_ = 0;
+    Buffer textPool_;
+    Buffer chunk_ = Buffer(kChunkSize * 2);
+    size_t used_ = 0;
+    std::vector<std::pair<size_t, size_t>> recent_;  // недавние элементы текущего блока
+    size_t recentPos_ = 0;
+};
+
+// Режим generate: main generate <файл> <число элементов> [--bytes=N] [--seed=S] [--spec=...]
+// При --bytes число элементов не задаётся, генерация идёт до нужного размера
+inline int runGenerate(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.empty()) {
+        std::cerr << "Usage: generate <file> <elements> [--bytes=N] [--seed=S] [--spec=...]\n";
+        return 1;
+    }
+    try {
+        PayloadGenerator generator(PayloadSpec::parse(args.option("spec", "")),
+                                   std::stoull(args.option("seed", "1")));
+        std::ofstream out(args.get(0, ""), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open " + args.get(0, ""));
+        }
+        auto start = std::chrono::steady_clock::now();
+        uint64_t elements = 0;
+        uint64_t written = 0;
+        std::string targetBytes = args.option("bytes", "");
+        if (!targetBytes.empty()) {
+            written = generator.generateBytes(out, std::stoull(targetBytes), elements);
+        } else {
+            elements = std::stoull(args.get(1, "1000"));
+            written = generator.generate(out, elements);
+        }
+        out.flush();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << "Generated " << elements << " elements, " << written << " bytes, "
+                  << static_cast<double>(written) / elapsed.count() / 1e9 << " GB/s\n";
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Режимы to-image/from-image: main to-image <wire> <образ> [--pack] [--align=8|64],
+// main from-image <образ> <wire>
+inline int runImageConvert(bool toImage, int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.size() < 2) {
+        std::cerr << "Usage: " << (toImage ? "to-image <wire> <image>" : "from-image <image> <wire>") << '\n';
+        return 1;
+    }
+    try {
+        Buffer output;
+        if (toImage) {
+            image::Writer::Options options;
+            options.packNumericVectors = args.options.count("pack") > 0;
+            options.alignment = std::stoul(args.option("align", "8"));
+            output = image::Writer::fromWire(readFile(args.get(0, "")), options);
+        } else {
+            MappedFile mapped(args.get(0, ""));
+            output = image::toWire(image::View(mapped.data(), mapped.size()));
+        }
+        std::ofstream out(args.get(1, ""), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        out.write(reinterpret_cast<const char*>(output.data()), static_cast<std::streamsize>(output.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write " + args.get(1, ""));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+inline int runJsonConvert(bool toJson, int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.size() < 2) {
+        std::cerr << "Usage: " << (toJson ? "to-json <wire> <json>" : "from-json <json> <wire> [--header]") << '\n';
+        return 1;
+    }
+    try {
+        std::ofstream out(args.get(1, ""), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        if (toJson) {
+            json::fromWire(readFile(args.get(0, "")), out);
+        } else {
+            MappedFile mapped(args.get(0, ""));
+            Buffer wire = json::toWire(std::string_view(reinterpret_cast<const char*>(mapped.data()), mapped.size()),
+                                       args.options.count("header") > 0);
+            out.write(reinterpret_cast<const char*>(wire.data()), static_cast<std::streamsize>(wire.size()));
+        }
+        if (!out) {
+            throw std::runtime_error("Failed to write " + args.get(1, ""));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+// Перевод в MessagePack/CBOR и обратно; format — "msgpack" или "cbor"
+inline int runBinaryConvert(const std::string& format, bool toForeign, int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.size() < 2) {
+        std::cerr << "Usage: " << (toForeign ? "to-" + format + " <wire> <output>" : "from-" + format + " <input> <wire> [--header]")
+                  << '\n';
+        return 1;
+    }
+    try {
+        Buffer output;
+        if (toForeign) {
+            Buffer wire = readFile(args.get(0, ""));
+            output = format == "cbor" ? cbor::fromWire(wire) : msgpack::fromWire(wire);
+        } else {
+            MappedFile mapped(args.get(0, ""));
+            bool withHeader = args.options.count("header") > 0;
+            output = format == "cbor" ? cbor::toWire(mapped.data(), mapped.size(), withHeader)
+                                      : msgpack::toWire(mapped.data(), mapped.size(), withHeader);
+        }
+        std::ofstream out(args.get(1, ""), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        out.write(reinterpret_cast<const char*>(output.data()), static_cast<std::streamsize>(output.size()));
+        if (!out) {
+            throw std::runtime_error("Failed to write " + args.get(1, ""));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+inline int runArrowExport(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.size() < 2) {
+        std::cerr << "Usage: to-arrow <wire> <arrows> [--names=a,b,...] [--batch=rows]\n";
+        return 1;
+    }
+    try {
+        arrow::StreamWriter::Options options;
+        options.rowsPerBatch = std::stoull(args.option("batch", "65536"));
+        std::stringstream names(args.option("names", ""));
+        for (std::string name; std::getline(names, name, ',');) {
+            options.names.push_back(name);
+        }
+        Buffer wire = readFile(args.get(0, ""));
+        std::ofstream out(args.get(1, ""), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        arrow::StreamWriter::fromWire(wire, out, options);
+        if (!out) {
+            throw std::runtime_error("Failed to write " + args.get(1, ""));
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+inline int runStats(int argc, char* argv[]) {
+    CommandLine args(argc, argv);
+    if (args.positional.empty()) {
+        std::cerr << "Usage: stats <file>\n";
+        return 1;
+    }
+    try {
+        MappedFile mapped(args.get(0, ""));
+        stats::Scanner scanner;
+        auto start = std::chrono::steady_clock::now();
+        const stats::Report& report = scanner.scan(mapped.data(), mapped.size());
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        report.print(std::cout, elapsed.count());
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "bench") {
+        return runBenchmark(argc - 2, argv + 2);
+    }
+    if (mode == "bench-compare") {
+        return runBenchmarkCompare(argc - 2, argv + 2);
+    }
+    if (mode == "generate") {
+        return runGenerate(argc - 2, argv + 2);
+    }
+    if (mode == "to-image" || mode == "from-image") {
+        return runImageConvert(mode == "to-image", argc - 2, argv + 2);
+    }
+    if (mode == "to-json" || mode == "from-json") {
+        return runJsonConvert(mode == "to-json", argc - 2, argv + 2);
+    }
+    if (mode == "stats") {
+        return runStats(argc - 2, argv + 2);
+    }
+    if (mode == "to-arrow") {
+        return runArrowExport(argc - 2, argv + 2);
+    }
+    for (const char* format : {"msgpack", "cbor"}) {
+        if (mode == std::string("to-") + format || mode == std::string("from-") + format) {
+            return runBinaryConvert(format, mode[0] == 't', argc - 2, argv + 2);
+        }
+    }
+
+    // Пример использования
+    Buffer buff;
+    try {
+        buff = readFile("raw.bin");
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+
+    try {
+        AllocationTracker::Scope decodeAllocations;
+        auto res = Serializator::deserialize(buff);
+        AllocationTracker::Stats decodeStats = decodeAllocations.delta();
+
+        Serializator s;
+        for (auto&& i : res)
+            s.push(i);
+
+        AllocationTracker::Scope encodeAllocations;
+        Buffer serialized = s.serialize(WireHeader::present(buff.data(), buff.size()));
+        AllocationTracker::Stats encodeStats = encodeAllocations.delta();
+
+        if (AllocationTracker::enabled()) {
+            std::cout << "Decoded tree: " << memoryFootprint(res) << " bytes in memory\n"
+                      << "Decode: " << decodeStats.allocations << " allocations, " << decodeStats.bytes << " bytes\n"
+                      << "Encode: " << encodeStats.allocations << " allocations, " << encodeStats.bytes << " bytes\n";
+        }
+
+        // Проверка на совпадение буферов
+        if (buff.size() != serialized.size() || !std::equal(buff.begin(), buff.end(), serialized.begin())) {
+            std::cout << "Buffers do not match.\n";
+        } else {
+            std::cout << "Buffers match.\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << '\n';
+    }
+
+#ifdef SERIALIZATOR_LATENCY_HISTOGRAM
+    CodecLatencyRecorder::exportPercentiles(std::cout);
+#endif
+    return 0;
 }
\ No newline at end of file